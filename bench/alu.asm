@@ -0,0 +1,31 @@
+; ALU-heavy loop: arithmetic, logic and shifts on registers only
+
+    org 0x00000800
+
+    call bench_start
+
+    mov r0, 1
+    mov r1, 0x12345678
+    mov r2, 3
+    mov r31, 200000
+alu_loop:
+    add r0, r1
+    mul r0, r2
+    xor r1, r0
+    sub r1, 7
+    and r0, 0x0FFFFFFF
+    or r1, 0x00010000
+    sla r2, 1
+    srl r2, 1
+    ror r1, 3
+    not r3
+    inc r2
+    dec r2
+    loop alu_loop
+
+    jmp bench_end
+
+    #include "bench.inc"
+
+    org.pad 0x000009FC
+    data.32 0x523C334C
@@ -0,0 +1,60 @@
+; the ALU loop on bytes and half words, with division and every shift and
+; rotate, to compare the .8 and .16 paths with .32
+
+    org 0x00000800
+
+    call bench_start
+
+    mov r0, 0x9E3779B9
+    mov r1, 0x3C6EF372
+    mov r2, 0xDAA66D2B
+    mov r31, 100000
+alu_narrow_loop:
+    add.8 r0, r1
+    sub.8 r0, r1
+    mul.8 r0, r1
+    imul.8 r0, r1
+    and.8 r0, r1
+    or.8 r0, r1
+    xor.8 r0, r1
+    div.8 r2, 3
+    rem.8 r2, 7
+    sla.8 r1, 3
+    srl.8 r1, 2
+    sra.8 r1, 5
+    rol.8 r1, 7
+    ror.8 r1, 3
+    inc.8 r0
+    dec.8 r2
+    not.8 r1
+
+    add.16 r0, r1
+    sub.16 r0, r1
+    mul.16 r0, r1
+    imul.16 r0, r1
+    and.16 r0, r1
+    or.16 r0, r1
+    xor.16 r0, r1
+    div.16 r2, 3
+    rem.16 r2, 7
+    sla.16 r1, 3
+    srl.16 r1, 2
+    sra.16 r1, 5
+    rol.16 r1, 7
+    ror.16 r1, 3
+    inc.16 r0
+    dec.16 r2
+    not.16 r1
+
+    mul r0, r1
+    div r2, 3
+    sla r1, 11
+    ror r1, 19
+    loop alu_narrow_loop
+
+    jmp bench_end
+
+    #include "bench.inc"
+
+    org.pad 0x000009FC
+    data.32 0x523C334C
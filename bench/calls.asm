@@ -0,0 +1,39 @@
+; stack-heavy code: nested calls that save and restore registers
+
+    org 0x00000800
+
+    call bench_start
+
+    mov r31, 50000
+calls_loop:
+    call calls_outer
+    loop calls_loop
+
+    jmp bench_end
+
+calls_outer:
+    push r0
+    push r1
+    push r2
+    push r3
+    call calls_inner
+    call calls_inner
+    pop r3
+    pop r2
+    pop r1
+    pop r0
+    ret
+
+calls_inner:
+    push r4
+    push r5
+    mov r4, rsp
+    mov r5, [r4]
+    pop r5
+    pop r4
+    ret
+
+    #include "bench.inc"
+
+    org.pad 0x000009FC
+    data.32 0x523C334C
@@ -0,0 +1,30 @@
+; 256 reads of pseudo-random sectors within the first 15 MiB of disk 0
+
+    org 0x00000800
+
+const BUFFER:  0x00010000
+const SECTORS: 30720
+
+    call bench_start
+
+    mov r0, 0x80002000
+    out r0, BUFFER           ; set the memory buffer location
+    mov r0, 0x80003000       ; read a sector from disk 0 into the buffer
+    mov r2, 12345            ; the same sequence every run
+    mov r31, 256
+disk_rand_loop:
+    ; a linear congruential generator
+    mul r2, 1103515245
+    add r2, 12345
+    mov r1, r2
+    srl r1, 8
+    rem r1, SECTORS
+    out r0, r1
+    loop disk_rand_loop
+
+    jmp bench_end
+
+    #include "bench.inc"
+
+    org.pad 0x000009FC
+    data.32 0x523C334C
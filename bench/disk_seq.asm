@@ -0,0 +1,24 @@
+; 1024 sequential sector reads from disk 0
+
+    org 0x00000800
+
+const BUFFER: 0x00010000
+
+    call bench_start
+
+    mov r0, 0x80002000
+    out r0, BUFFER           ; set the memory buffer location
+    mov r0, 0x80003000       ; read a sector from disk 0 into the buffer
+    mov r1, 0
+    mov r31, 1024
+disk_seq_loop:
+    out r0, r1
+    inc r1
+    loop disk_seq_loop
+
+    jmp bench_end
+
+    #include "bench.inc"
+
+    org.pad 0x000009FC
+    data.32 0x523C334C
@@ -0,0 +1,42 @@
+; byte and word memory copies of 64 KiB, four times each
+
+    org 0x00000800
+
+const SOURCE:      0x00010000
+const DESTINATION: 0x00020000
+const LENGTH:      0x00010000
+
+    call bench_start
+
+    mov r10, 4
+memcpy_repeat:
+    ; one byte at a time
+    mov r0, SOURCE
+    mov r1, DESTINATION
+    mov r31, LENGTH
+memcpy_byte_loop:
+    mov.8 [r1], [r0]
+    inc r0
+    inc r1
+    loop memcpy_byte_loop
+
+    ; one word at a time
+    mov r0, SOURCE
+    mov r1, DESTINATION
+    mov r31, LENGTH
+    srl r31, 2
+memcpy_word_loop:
+    mov [r1], [r0]
+    add r0, 4
+    add r1, 4
+    loop memcpy_word_loop
+
+    dec r10
+    ifnz jmp memcpy_repeat
+
+    jmp bench_end
+
+    #include "bench.inc"
+
+    org.pad 0x000009FC
+    data.32 0x523C334C
@@ -0,0 +1,8 @@
+; paging with a working set of half as many pages as fit in physical memory
+
+    org 0x00000800
+
+const WORKING_SET_MUL: 1
+const WORKING_SET_DIV: 2
+
+    #include "paging.inc"
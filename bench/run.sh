@@ -0,0 +1,71 @@
+#!/bin/sh
+# run the guest benchmarks under the host build and write one line of
+# results per benchmark and page size, tab separated, to $BENCH_OUTPUT
+#
+# usage: bench/run.sh [page size...]    (default: 4096)
+#
+# each benchmark is a boot sector, assembled with $FOX32ASM and written to
+# the start of a blank disk image. it resets the performance counters when
+# it starts and powers off when it is done, so the numbers leave out the
+# boot. the benchmarks are assembled again for each page size, with
+# geometry.inc giving the page size and the number of physical pages
+#
+# seconds are counted in video frames, and the host build times its frames
+# with the host's clock. so seconds and instructions_per_second are host
+# wall-clock figures that vary with the machine and its load, not
+# cycle-accurate AVR time. the counters are exact and repeatable
+
+set -e
+
+cd "$(dirname "$0")/.."
+
+FOX32ASM=${FOX32ASM:-../fox32asm/target/release/fox32asm}
+BENCH_OUTPUT=${BENCH_OUTPUT:-bench_output.txt}
+# give up on a benchmark after this many frames
+BENCH_FRAMES=${BENCH_FRAMES:-36000}
+PAGE_SIZES=${*:-4096}
+BENCHMARKS="alu alu_narrow memcpy calls skips paging_half paging_full paging_double disk_seq disk_rand terminal"
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+printf 'benchmark\tpage_size\tinstructions\tseconds\tinstructions_per_second\tpage_faults\tevictions\twritebacks\tsd_sectors_read\tsd_sectors_written\tspi_bytes\n' > "$BENCH_OUTPUT"
+
+for page_size in $PAGE_SIZES; do
+    # as FOX32_PHYSICAL_PAGES in cpu.h
+    physical_pages=$((0x20000 / page_size))
+    if [ $physical_pages -gt 255 ]; then physical_pages=255; fi
+
+    rm -rf "$WORK/src"
+    mkdir "$WORK/src"
+    cp bench/*.asm bench/*.inc "$WORK/src"
+    printf 'const PAGE_SIZE: %d\nconst PHYSICAL_PAGES: %d\n' $page_size $physical_pages > "$WORK/src/geometry.inc"
+    for bench in $BENCHMARKS; do
+        (cd "$WORK/src" && "$FOX32ASM" $bench.asm "$WORK/$bench.bin")
+    done
+
+    make -s host UZEFOX_OPTIONS="-DPERF_COUNTERS -DFOX32_PAGE_SIZE=$page_size" -B
+
+    for bench in $BENCHMARKS; do
+        mkdir -p "$WORK/sd"
+        rm -f "$WORK/sd/DISK0.IMG"
+        truncate -s 16M "$WORK/sd/DISK0.IMG"
+        dd if="$WORK/$bench.bin" of="$WORK/sd/DISK0.IMG" conv=notrunc 2>/dev/null
+
+        UZEFOX_SD="$WORK/sd" UZEFOX_FRAMES=$BENCH_FRAMES \
+            ./bin/uzefox-host < /dev/null > /dev/null 2> "$WORK/counters"
+
+        awk -v bench=$bench -v page_size=$page_size '
+            { counter[$1] = $2 }
+            END {
+                seconds = counter["frames_counted"] / 59.94
+                printf "%s\t%s\t%d\t%.2f\t%d\t%d\t%d\t%d\t%d\t%d\t%d\n",
+                    bench, page_size, counter["instructions"], seconds,
+                    (seconds > 0 ? counter["instructions"] / seconds : 0),
+                    counter["page_faults"], counter["evictions"], counter["writebacks"],
+                    counter["sd_sectors_read"], counter["sd_sectors_written"], counter["spi_bytes"]
+            }' "$WORK/counters" >> "$BENCH_OUTPUT"
+    done
+done
+
+cat "$BENCH_OUTPUT"
@@ -0,0 +1,29 @@
+; conditional-skip-heavy code: most conditional instructions are skipped
+
+    org 0x00000800
+
+    call bench_start
+
+    mov r0, 0
+    mov r31, 200000
+skips_loop:
+    inc r0
+    cmp r0, 0
+    ifz mov r1, 1
+    ifz add r2, 1
+    cmp r0, 0xFFFFFFFF
+    ifgteq mov r1, 2
+    ifgteq add r2, 2
+    bts r0, 31
+    ifnz mov r1, 3
+    ifnz add r2, 3
+    iflt mov r1, 4
+    ifc add r2, 4
+    loop skips_loop
+
+    jmp bench_end
+
+    #include "bench.inc"
+
+    org.pad 0x000009FC
+    data.32 0x523C334C
@@ -0,0 +1,33 @@
+; terminal output: 1000 lines through the serial port a byte at a time,
+; then 1000 more through the buffered write port
+
+    org 0x00000800
+
+const TERMINAL_LINE_LENGTH: 31
+
+    call bench_start
+
+    mov r31, 1000
+terminal_byte_loop:
+    mov r0, terminal_line
+terminal_byte_char:
+    out 0, [r0]
+    inc r0
+    cmp.8 [r0], 0
+    ifnz jmp terminal_byte_char
+    loop terminal_byte_loop
+
+    out 1, terminal_line     ; set the write pointer
+    mov r31, 1000
+terminal_write_loop:
+    out 2, TERMINAL_LINE_LENGTH
+    loop terminal_write_loop
+
+    jmp bench_end
+
+terminal_line: data.str "the quick brown fox jumps over" data.8 10 data.8 0
+
+    #include "bench.inc"
+
+    org.pad 0x000009FC
+    data.32 0x523C334C
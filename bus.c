@@ -10,11 +10,20 @@
 #include "bus.h"
 #include "cpu.h"
 #include "disk.h"
+#include "irq.h"
+#include "overlay.h"
+#include "perf.h"
+#include "profile.h"
+#include "sample.h"
 #include "serial.h"
+#include "timer.h"
+#include "trace.h"
 
 extern fox32_vm_t vm;
 extern disk_controller_t disk_controller;
 
+uint8_t power_request = POWER_ON;
+
 int bus_io_read(void *user, uint32_t *value, uint32_t port) {
     (void) user;
     switch (port) {
@@ -23,6 +32,66 @@ int bus_io_read(void *user, uint32_t *value, uint32_t port) {
             break;
         };
 
+        case 0x80000000 ... 0x8000031F: { // overlay port
+            uint8_t overlay = port & 0x000000FF;
+            switch (port & 0x00000F00) {
+                case 0x00000000: {
+                    // overlay position, in tiles
+                    *value = overlay_get_position(overlay);
+                    break;
+                };
+                case 0x00000100: {
+                    // overlay size, in tiles
+                    *value = overlay_get_size(overlay);
+                    break;
+                };
+                case 0x00000200: {
+                    // overlay pointer
+                    *value = overlay_get_pointer(overlay);
+                    break;
+                };
+                case 0x00000300: {
+                    // overlay enable status
+                    *value = overlay_get_enabled(overlay);
+                    break;
+                };
+            }
+
+            break;
+        };
+
+        case 0x80000501: { // number of keys waiting on the serial port
+            *value = serial_pending();
+            break;
+        };
+
+        case 0x80000706: { // milliseconds since startup
+            *value = timer_get_ms();
+            break;
+        };
+
+        case 0x80000800 ... 0x80000813: { // interrupt controller port
+            switch (port & 0xFF) {
+                case 0x00: {
+                    // enabled interrupt sources
+                    *value = irq_get_enabled();
+                    break;
+                };
+                case 0x01: {
+                    // pending interrupt sources
+                    *value = irq_get_pending();
+                    break;
+                };
+                case 0x10 ... 0x13: {
+                    // vector of each interrupt source
+                    *value = irq_get_vector(port & 0x0F);
+                    break;
+                };
+            }
+
+            break;
+        };
+
         case 0x80001000 ... 0x80002003: { // disk controller port
             size_t id = port & 0xFF;
             uint8_t operation = (port & 0x0000F000) >> 8;
@@ -42,6 +111,51 @@ int bus_io_read(void *user, uint32_t *value, uint32_t port) {
 
             break;
         };
+
+        case 0x80006000 ... 0x80006005: { // disk queue port
+            switch (port & 0xFF) {
+                case 0x03: {
+                    // submission entries consumed so far
+                    *value = disk_controller.queue.submission_head;
+                    break;
+                };
+                case 0x04: {
+                    // completion entries posted so far
+                    *value = disk_controller.queue.completion_tail;
+                    break;
+                };
+            }
+
+            break;
+        };
+
+#ifdef PERF_COUNTERS
+        case 0x80007000 ... 0x800070FF: { // performance counter port
+            *value = perf_read(port & 0xFF);
+            break;
+        };
+#endif
+
+#ifdef OPCODE_PROFILE
+        case 0x80008000 ... 0x800082FF: { // opcode profile port
+            *value = profile_read(port & 0xFFF);
+            break;
+        };
+#endif
+
+#ifdef PC_SAMPLING
+        case 0x80009000 ... 0x800090FF: { // pc sampling port
+            *value = sample_read(port & 0xFF);
+            break;
+        };
+#endif
+
+#ifdef INSTRUCTION_TRACE
+        case 0x8000A000 ... 0x8000A0FF: { // instruction trace port
+            *value = trace_read(port & 0xFF);
+            break;
+        };
+#endif
     }
 
     return 0;
@@ -55,9 +169,116 @@ int bus_io_write(void *user, uint32_t value, uint32_t port) {
             break;
         };
 
+        case 0x00000001: { // serial write buffer pointer
+            serial_set_write_pointer(value);
+            break;
+        };
+
+        case 0x00000002: { // serial write buffer: print this many bytes
+            // a bad buffer makes the out fault, as a bus error
+            if (serial_write(&vm, value) != FOX32_ERR_OK) return 1;
+            break;
+        };
+
+        case 0x00000003: { // text framebuffer commit
+            serial_framebuffer_commit();
+            break;
+        };
+
+        case 0x80000000 ... 0x8000041F: { // overlay port
+            uint8_t overlay = port & 0x000000FF;
+            switch (port & 0x00000F00) {
+                case 0x00000000: {
+                    // overlay position, in tiles
+                    overlay_set_position(overlay, value);
+                    break;
+                };
+                case 0x00000100: {
+                    // overlay size, in tiles
+                    overlay_set_size(overlay, value);
+                    break;
+                };
+                case 0x00000200: {
+                    // overlay pointer
+                    overlay_set_pointer(overlay, value);
+                    break;
+                };
+                case 0x00000300: {
+                    // overlay enable status
+                    overlay_set_enabled(overlay, value != 0);
+                    break;
+                };
+                case 0x00000400: {
+                    // mark a row, or 0xFFFFFFFF for all rows, as changed
+                    overlay_mark_dirty(overlay, value);
+                    break;
+                };
+            }
+
+            break;
+        };
+
+        case 0x80010000: { // power port: 0 powers off, 1 resets, 2 snapshots
+            if (value == 1)
+                power_request = POWER_RESET;
+            else if (value == 2)
+                power_request = POWER_SNAPSHOT;
+            else
+                power_request = POWER_OFF;
+            // stop after this instruction so the main loop sees it
+            vm.halted = true;
+            break;
+        };
+
+        case 0x80000710 ... 0x80000712: { // timer port
+            switch (port & 0xFF) {
+                case 0x10: {
+                    // set the timer period in ms
+                    timer_set_period(value);
+                    break;
+                };
+                case 0x11: {
+                    // set the timer mode: 0 = off, 1 = one-shot, 2 = periodic
+                    timer_set_mode(value);
+                    break;
+                };
+                case 0x12: {
+                    // set the timer interrupt vector
+                    timer_set_vector(value);
+                    break;
+                };
+            }
+
+            break;
+        };
+
+        case 0x80000800 ... 0x80000813: { // interrupt controller port
+            switch (port & 0xFF) {
+                case 0x00: {
+                    // enable interrupt sources: bit 0 timer, 1 disk queue,
+                    // 2 keyboard, 3 vsync
+                    irq_set_enabled(value);
+                    break;
+                };
+                case 0x01: {
+                    // drop pending interrupts
+                    irq_acknowledge(value);
+                    break;
+                };
+                case 0x10 ... 0x13: {
+                    // set the vector of an interrupt source
+                    irq_set_vector(port & 0x0F, value);
+                    break;
+                };
+            }
+
+            break;
+        };
+
         case 0x80001000 ... 0x80005003: { // disk controller port
             size_t id = port & 0xFF;
             uint8_t operation = (port & 0x0000F000) >> 8;
+            PERF_COUNT(PERF_DISK_COMMANDS, 1);
             switch (operation) {
                 case 0x10: {
                     // no-op
@@ -89,6 +310,84 @@ int bus_io_write(void *user, uint32_t value, uint32_t port) {
 
             break;
         };
+
+        case 0x80006000 ... 0x80006005: { // disk queue port
+            disk_queue_t *queue = &disk_controller.queue;
+            switch (port & 0xFF) {
+                case 0x00: {
+                    // set the submission ring pointer
+                    queue->submission_ring = value;
+                    break;
+                };
+                case 0x01: {
+                    // set the completion ring pointer
+                    queue->completion_ring = value;
+                    break;
+                };
+                case 0x02: {
+                    // set the ring size and reset the queue, zero disables it
+                    queue->entries = (value <= 128 && (value & (value - 1)) == 0) ? value : 0;
+                    queue->submission_head = 0;
+                    queue->submission_tail = 0;
+                    queue->completion_head = 0;
+                    queue->completion_tail = 0;
+                    queue->busy = false;
+                    irq_acknowledge(1 << IRQ_DISK);
+                    break;
+                };
+                case 0x03: {
+                    // doorbell: new submission tail
+                    PERF_COUNT(PERF_DISK_COMMANDS, (uint8_t) (value - queue->submission_tail));
+                    queue->submission_tail = value;
+                    break;
+                };
+                case 0x04: {
+                    // completion entries consumed by the guest
+                    queue->completion_head = value;
+                    break;
+                };
+                case 0x05: {
+                    // set the completion interrupt vector, above 0xFF disables it
+                    if (value <= 0xFF) {
+                        irq_set_vector(IRQ_DISK, value);
+                        irq_set_enabled(irq_get_enabled() | (1 << IRQ_DISK));
+                    } else {
+                        irq_set_enabled(irq_get_enabled() & ~(1 << IRQ_DISK));
+                    }
+                    break;
+                };
+            }
+
+            break;
+        };
+
+#ifdef PERF_COUNTERS
+        case 0x80007000: { // performance counter port
+            perf_command(value);
+            break;
+        };
+#endif
+
+#ifdef OPCODE_PROFILE
+        case 0x80008000: { // opcode profile port: clear
+            profile_reset();
+            break;
+        };
+#endif
+
+#ifdef PC_SAMPLING
+        case 0x80009000: { // pc sampling port
+            sample_command(&vm, value);
+            break;
+        };
+#endif
+
+#ifdef INSTRUCTION_TRACE
+        case 0x8000A000: { // instruction trace port
+            trace_command(value);
+            break;
+        };
+#endif
     }
 
     return 0;
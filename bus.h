@@ -1,5 +1,17 @@
 #pragma once
 
+#include <stdint.h>
+
+enum {
+    POWER_ON,
+    POWER_OFF,
+    POWER_RESET,
+    POWER_SNAPSHOT
+};
+
+// set by the power port, handled by the main loop
+extern uint8_t power_request;
+
 int bus_io_read(void *user, uint32_t *value, uint32_t port);
 int bus_io_write(void *user, uint32_t value, uint32_t port);
 void drop_file(char *filename);
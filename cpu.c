@@ -9,6 +9,12 @@
 
 #include "cpu.h"
 #include "disk.h"
+#include "fastmem.h"
+#include "perf.h"
+#include "profile.h"
+#include "sample.h"
+#include "trace.h"
+#include "serial.h"
 
 #include "smolrom.h"
 
@@ -153,6 +159,9 @@ static void vm_init(vm_t *vm) {
     vm->soft_halted = false;
     vm->mmu_enabled = false;
     vm->is_consecutive_read = false;
+    memset(vm->physical_page_holds, 0xFF, sizeof(vm->physical_page_holds));
+    memset(vm->physical_page_directory, 0xFF, sizeof(vm->physical_page_directory));
+    memset(vm->physical_page_leaf_owner, 0xFF, sizeof(vm->physical_page_leaf_owner));
     vm->io_user = NULL;
     vm->io_read = io_read_default;
     vm->io_write = io_write_default;
@@ -171,9 +180,11 @@ static uint32_t vm_io_read(vm_t *vm, uint32_t port) {
     if (status != 0) {
         vm_panic(vm, FOX32_ERR_IOREAD);
     }
+    TRACE_IO(TRACE_RECORD_IO_READ, port, value);
     return value;
 }
 static void vm_io_write(vm_t *vm, uint32_t port, uint32_t value) {
+    TRACE_IO(TRACE_RECORD_IO_WRITE, port, value);
     int status = vm->io_write(vm->io_user, value, port);
     if (status != 0) {
         vm_panic(vm, FOX32_ERR_IOWRITE);
@@ -209,94 +220,132 @@ static uint32_t *vm_findlocal(vm_t *vm, uint8_t local) {
     vm_panic(vm, FOX32_ERR_BADREGISTER);
 }
 
-static uint8_t spi_read8(vm_t *vm, uint32_t address) {
-    if ((!vm->is_consecutive_read) && (address == vm->previous_read_address + 1)) {
-        vm->is_consecutive_read = true;
-        vm->previous_read_address = address;
-        u8 bank = 0;
-        if (address > 0xFFFF) {
-            bank = 1;
-            address &= 0xFFFF;
-        }
-        SpiRamSeqReadStart(bank, (u16) address);
-        return SpiRamSeqReadU8();
-    }
-    if ((vm->is_consecutive_read) && (address == vm->previous_read_address + 1)) {
-        vm->previous_read_address = address;
-        return SpiRamSeqReadU8();
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "vm_local_set stores the low bytes of a register first"
+#endif
+
+// store a .8 or .16 result into the low bytes of a register, leaving the
+// rest alone, without a 32 bit read-modify-write on the AVR
+static inline void vm_local_set(uint32_t *local, uint32_t value, uint8_t size) {
+    uint8_t *bytes = (uint8_t *) local;
+    switch (size) {
+        case SIZE8: bytes[0] = value; break;
+        case SIZE16: bytes[0] = value; bytes[1] = value >> 8; break;
+        default: *local = value; break;
     }
-    vm->previous_read_address = address;
+}
+
+#ifdef FASTMEM_SELF_CHECK
+// compare what the fast path did with what the SPI RAM library sees
+static void fastmem_check(vm_t *vm, uint32_t address, uint32_t value, uint8_t length) {
     if (vm->is_consecutive_read) {
         vm->is_consecutive_read = false;
         SpiRamSeqReadEnd();
-        u8 bank = 0;
-        if (address > 0xFFFF) {
-            bank = 1;
-            address &= 0xFFFF;
+    }
+    for (uint8_t i = 0; i < length; i++) {
+        u8 bank = (address + i) > 0xFFFF ? 1 : 0;
+        if (SpiRamReadU8(bank, (u16) (address + i)) != (uint8_t) (value >> (i * 8))) {
+            vm->exception_operand = address;
+            vm_panic(vm, FOX32_ERR_INTERNAL);
         }
-        return SpiRamReadU8(bank, (u16) address);
+    }
+}
+#define FASTMEM_CHECK(_vm, _address, _value, _length) fastmem_check((_vm), (_address), (_value), (_length))
+#else
+#define FASTMEM_CHECK(_vm, _address, _value, _length) ((void) 0)
+#endif
+
+// read length bytes at a physical address, carrying on with the last read
+// if this follows straight on from it
+static uint32_t spi_read(vm_t *vm, uint32_t address, uint8_t length) {
+    PERF_COUNT(PERF_SPI_BYTES, length);
+    uint32_t value;
+    if ((vm->is_consecutive_read) && (address == vm->previous_read_address + 1)) {
+        value = spi_fast_read_next(length);
     } else {
-        u8 bank = 0;
-        if (address > 0xFFFF) {
-            bank = 1;
-            address &= 0xFFFF;
-        }
-        return SpiRamReadU8(bank, (u16) address);
+        if (vm->is_consecutive_read) SpiRamSeqReadEnd();
+        value = spi_fast_read_start(address, length);
+        vm->is_consecutive_read = true;
     }
+    vm->previous_read_address = address + length - 1;
+    FASTMEM_CHECK(vm, address, value, length);
+    return value;
+}
+
+// the physical address of a guest RAM address, paging it in if it has to
+static uint32_t vm_translate(vm_t *vm, uint32_t address) {
+    uint16_t page = address / FOX32_PAGE_SIZE;
+    uint32_t offset = address % FOX32_PAGE_SIZE;
+    uint8_t physical_page = find_physical_page(vm, page);
+    if (physical_page == 0xFF) {
+        // nope! load it into memory
+        load_page_in(vm, page);
+        physical_page = find_physical_page(vm, page);
+        // load_page_in always maps it. if it ever didn't, stop here rather
+        // than use physical page 0xFF
+        if (physical_page == 0xFF) vm_panic(vm, FOX32_ERR_INTERNAL);
+    }
+    return ((uint32_t) physical_page * (uint32_t) FOX32_PAGE_SIZE) + offset;
+}
+
+// true if length bytes at this address are all in the same page of RAM
+static inline bool in_ram_page(uint32_t address, uint8_t length) {
+    return address < FOX32_MEMORY_RAM &&
+           (address % FOX32_PAGE_SIZE) <= FOX32_PAGE_SIZE - length;
+}
+
+// ROM space is looked up by 4 KiB region, as far as the last jump table.
+// each entry is where the region starts in fox32_rom, in 256 byte units.
+// smolrom keeps the jump tables at 0x3000 and up, not where the API has them
+#define ROM_REGION_SHIFT 12
+#define ROM_REGION_COUNT 0x48
+#define ROM_REGION_NONE 0xFF
+#define ROM_NONE 0xFFFF
+
+#if FOX32_MEMORY_ROM != 0x4000
+#error "rom_regions maps a 16 KiB ROM"
+#endif
+
+static const uint8_t rom_regions[ROM_REGION_COUNT] PROGMEM = {
+    [0x00] = 0x00, [0x01] = 0x10, [0x02] = 0x20, [0x03] = 0x30,
+    [0x04 ... 0x3F] = ROM_REGION_NONE,
+    [0x40] = 0x30, // system jump table
+    [0x41 ... 0x44] = ROM_REGION_NONE,
+    [0x45] = 0x31, // disk jump table
+    [0x46] = 0x32, // memory jump table
+    [0x47] = 0x33, // integer jump table
+};
+
+// where length bytes at this address are in fox32_rom, or ROM_NONE if they
+// aren't all there. only the first 16 KiB of regions follow on from each
+// other, and a read running off the end of any other region also runs off
+// the end of fox32_rom
+static inline uint16_t rom_offset(uint32_t address, uint8_t length) {
+    uint32_t rom_address = address - FOX32_MEMORY_ROM_START;
+    if (rom_address >= ((uint32_t) ROM_REGION_COUNT << ROM_REGION_SHIFT)) return ROM_NONE;
+    uint8_t region = pgm_read_byte(&(rom_regions[rom_address >> ROM_REGION_SHIFT]));
+    if (region == ROM_REGION_NONE) return ROM_NONE;
+    uint16_t offset = ((uint16_t) region << 8) + ((uint16_t) rom_address & 0x0FFF);
+    if (offset + length > FOX32_MEMORY_ROM) return ROM_NONE;
+    return offset;
 }
+
 static uint8_t vm_read8(vm_t *vm, uint32_t address) {
     uint32_t address_end = address + 1;
 
     if (address_end > address) {
         if (address_end <= FOX32_MEMORY_RAM) {
-            // is this page in memory?
-            uint8_t page = address / 4096;
-            uint32_t offset = address % 4096;
-            if (vm->page_is_in_memory_bitmap[page / 8] & (1 << (page % 8))) {
-                // yes! find where it is
-                address = ((uint32_t) vm->page_on_disk_is_at[page] * (uint32_t) 4096) + offset;
-            } else {
-                // nope! load it into memory
-                load_page_in(vm, page);
-                address = ((uint32_t) vm->page_on_disk_is_at[page] * (uint32_t) 4096) + offset;
-            }
-            return spi_read8(vm, address);
+            return spi_read(vm, vm_translate(vm, address), 1);
         }
 
-        // special case for the system jump table
-        if (
-            (address >= FOX32_MEMORY_ROM_START + 0x40000) &&
-            (address <= FOX32_MEMORY_ROM_START + 0x40FFF)
-        ) {
-            address -= 0x40000 - 0x3000;
-        }
-        // special case for the disk jump table
-        else if (
-            (address >= FOX32_MEMORY_ROM_START + 0x45000) &&
-            (address <= FOX32_MEMORY_ROM_START + 0x45FFF)
-        ) {
-            address -= 0x45000 - 0x3100;
-        }
-        // special case for the memory jump table
-        else if (
-            (address >= FOX32_MEMORY_ROM_START + 0x46000) &&
-            (address <= FOX32_MEMORY_ROM_START + 0x46FFF)
-        ) {
-            address -= 0x46000 - 0x3200;
-        }
-        // special case for the integer jump table
-        else if (
-            (address >= FOX32_MEMORY_ROM_START + 0x47000) &&
-            (address <= FOX32_MEMORY_ROM_START + 0x47FFF)
-        ) {
-            address -= 0x47000 - 0x3300;
+        // the text framebuffer is write only
+        if (address >= TEXT_FRAMEBUFFER_CHARS && address < TEXT_FRAMEBUFFER_END) {
+            return 0;
         }
 
-        if (
-            (address >= FOX32_MEMORY_ROM_START) &&
-            (address -= FOX32_MEMORY_ROM_START) + 1 <= FOX32_MEMORY_ROM
-        ) {
-            return pgm_read_byte(&(fox32_rom[address]));
+        uint16_t offset = rom_offset(address, 1);
+        if (offset != ROM_NONE) {
+            return pgm_read_byte(&(fox32_rom[offset]));
         }
     }
     vm->exception_operand = address;
@@ -306,6 +355,15 @@ static uint16_t vm_read16(vm_t *vm, uint32_t address) {
     uint32_t address_end = address + 2;
 
     if (address_end > address) {
+        // instruction fetches from ROM, the hottest code, skip paging
+        uint16_t offset = rom_offset(address, 2);
+        if (offset != ROM_NONE) {
+            return pgm_read_word(&(fox32_rom[offset]));
+        }
+        if (in_ram_page(address, 2)) {
+            return spi_read(vm, vm_translate(vm, address), 2);
+        }
+
         uint16_t value = (uint32_t) vm_read8(vm, address) |
                          (uint32_t) vm_read8(vm, address + 1) << 8;
         return value;
@@ -317,6 +375,14 @@ static uint32_t vm_read32(vm_t *vm, uint32_t address) {
     uint32_t address_end = address + 4;
 
     if (address_end > address) {
+        uint16_t offset = rom_offset(address, 4);
+        if (offset != ROM_NONE) {
+            return pgm_read_dword(&(fox32_rom[offset]));
+        }
+        if (in_ram_page(address, 4)) {
+            return spi_read(vm, vm_translate(vm, address), 4);
+        }
+
         uint32_t value = (uint32_t) vm_read8(vm, address) |
                          ((uint32_t) vm_read8(vm, address + 1) << 8) |
                          ((uint32_t) vm_read8(vm, address + 2) << 16) |
@@ -327,36 +393,49 @@ static uint32_t vm_read32(vm_t *vm, uint32_t address) {
     vm_panic(vm, FOX32_ERR_FAULT_RD);
 }
 
-static void vm_write8(vm_t *vm, uint32_t address, uint8_t value) {
+// write length bytes at a guest RAM address, all in the same page
+static void spi_write(vm_t *vm, uint32_t address, uint32_t value, uint8_t length) {
     if (vm->is_consecutive_read) {
         vm->is_consecutive_read = false;
         SpiRamSeqReadEnd();
     }
 
-    // is this page in memory?
-    uint8_t page = address / 4096;
-    uint32_t offset = address % 4096;
-    if (vm->page_is_in_memory_bitmap[page / 8] & (1 << (page % 8))) {
-        // yes! find where it is
-        address = ((uint32_t) vm->page_on_disk_is_at[page] * (uint32_t) 4096) + offset;
-    } else {
-        // nope! load it into memory
-        load_page_in(vm, page);
-        address = ((uint32_t) vm->page_on_disk_is_at[page] * (uint32_t) 4096) + offset;
-    }
+    address = vm_translate(vm, address);
+
+    // remember that it needs writing back to swap
+    uint8_t physical_page = address / FOX32_PAGE_SIZE;
+    vm->physical_memory_dirty_bitmap[physical_page / 8] |= (1 << (physical_page % 8));
 
-    u8 bank = 0;
-    if (address > 0xFFFF) {
-        bank = 1;
-        address &= 0xFFFF;
+    spi_fast_write(address, value, length);
+    PERF_COUNT(PERF_SPI_BYTES, length);
+    FASTMEM_CHECK(vm, address, value, length);
+}
+
+static void vm_write8(vm_t *vm, uint32_t address, uint8_t value) {
+    if (address >= FOX32_MEMORY_RAM) {
+        // the text framebuffer goes straight to video memory
+        if (address >= TEXT_FRAMEBUFFER_CHARS && address < TEXT_FRAMEBUFFER_END) {
+            serial_framebuffer_write(address, value);
+            return;
+        }
+        vm->exception_operand = address;
+        vm_panic(vm, FOX32_ERR_FAULT_WR);
     }
-    SpiRamWriteU8(bank, (u16) address, value);
+    spi_write(vm, address, value, 1);
 }
 static void vm_write16(vm_t *vm, uint32_t address, uint16_t value) {
+    if (in_ram_page(address, 2)) {
+        spi_write(vm, address, value, 2);
+        return;
+    }
     vm_write8(vm, address, value & 0xFF);
     vm_write8(vm, address + 1, value >> 8);
 }
 static void vm_write32(vm_t *vm, uint32_t address, uint32_t value) {
+    if (in_ram_page(address, 4)) {
+        spi_write(vm, address, value, 4);
+        return;
+    }
     vm_write8(vm, address, value & 0xFF);
     vm_write8(vm, address + 1, (value >> 8) & 0xFF);
     vm_write8(vm, address + 2, (value >> 16) & 0xFF);
@@ -434,13 +513,13 @@ static uint32_t vm_source32_stay(vm_t *vm, uint8_t prtype, uint8_t offset) {
     VM_SOURCE_BODY(vm_read32, SIZE32, uint32_t, false, offset)
 }
 
-#define VM_TARGET_BODY(_vm_write, _localvalue, _offset)                          \
+#define VM_TARGET_BODY(_vm_write, _localsize, _offset)                           \
     uint32_t pointer_base = vm->pointer_instr_mut;                               \
     switch (prtype) {                                                            \
         case TY_REG: {                                                           \
             vm->pointer_instr_mut += SIZE8;                                      \
             uint8_t local = vm_read8(vm, pointer_base);                          \
-            *vm_findlocal(vm, local) = _localvalue;                              \
+            vm_local_set(vm_findlocal(vm, local), value, _localsize);            \
             return;                                                              \
         };                                                                       \
         case TY_REGPTR: {                                                        \
@@ -462,19 +541,19 @@ static uint32_t vm_source32_stay(vm_t *vm, uint8_t prtype, uint8_t offset) {
     vm_unreachable(vm);
 
 static void vm_target8(vm_t *vm, uint8_t prtype, uint8_t value, uint8_t offset) {
-    VM_TARGET_BODY(vm_write8, (*vm_findlocal(vm, local) & 0xFFFFFF00) | (uint32_t) value, offset)
+    VM_TARGET_BODY(vm_write8, SIZE8, offset)
 }
 static void vm_target8_zero(vm_t *vm, uint8_t prtype, uint8_t value, uint8_t offset) {
-    VM_TARGET_BODY(vm_write32, (uint32_t) value, offset)
+    VM_TARGET_BODY(vm_write32, SIZE32, offset)
 }
 static void vm_target16(vm_t *vm, uint8_t prtype, uint16_t value, uint8_t offset) {
-    VM_TARGET_BODY(vm_write16, (*vm_findlocal(vm, local) & 0xFFFF0000) | (uint32_t) value, offset)
+    VM_TARGET_BODY(vm_write16, SIZE16, offset)
 }
 static void vm_target16_zero(vm_t *vm, uint8_t prtype, uint16_t value, uint8_t offset) {
-    VM_TARGET_BODY(vm_write32, (uint32_t) value, offset)
+    VM_TARGET_BODY(vm_write32, SIZE32, offset)
 }
 static void vm_target32(vm_t *vm, uint8_t prtype, uint32_t value, uint8_t offset) {
-    VM_TARGET_BODY(vm_write32, value, offset)
+    VM_TARGET_BODY(vm_write32, SIZE32, offset)
 }
 
 static bool vm_shouldskip(vm_t *vm, uint8_t condition) {
@@ -516,28 +595,113 @@ static void vm_skipparam(vm_t *vm, uint32_t size, uint8_t prtype, uint8_t offset
     }
 }
 
+// 32 bit arithmetic for the AVR, which has an 8x8 multiplier, no divider
+// and only shifts by one bit at a time. the .8 and .16 instructions stay
+// in plain C, which the compiler already turns into a few instructions
+
+// a 32x32 multiply made of 16x16 ones, which use mul, instead of the 64
+// bit product __builtin_mul_overflow works out. returns the carry
+static bool mul32(uint32_t a, uint32_t b, uint32_t *out) {
+    uint16_t a_low = a, a_high = a >> 16;
+    uint16_t b_low = b, b_high = b >> 16;
+    uint32_t low = (uint32_t) a_low * b_low;
+    if (a_high && b_high) {
+        uint16_t cross = (unsigned int) a_high * b_low + (unsigned int) a_low * b_high;
+        *out = low + ((uint32_t) cross << 16);
+        return true;
+    }
+    // only one of the cross products can be nonzero
+    uint32_t cross = 0;
+    if (a_high) cross = (uint32_t) a_high * b_low;
+    else if (b_high) cross = (uint32_t) a_low * b_high;
+    *out = low + (cross << 16);
+    return cross > 0xFFFF || *out < low;
+}
+static bool imul32(int32_t a, int32_t b, int32_t *out) {
+    bool negative = (a < 0) != (b < 0);
+    uint32_t magnitude;
+    bool carry = mul32(a < 0 ? -(uint32_t) a : (uint32_t) a,
+                       b < 0 ? -(uint32_t) b : (uint32_t) b, &magnitude);
+    *out = negative ? -magnitude : magnitude;
+    return carry || magnitude > (negative ? 0x80000000 : 0x7FFFFFFF);
+}
+
+// 32 bit division is a long loop, so divide numbers that fit in 16 bits
+// as 16 bit ones. signed division works on the magnitudes, rounding
+// towards zero, with the remainder taking the sign of the dividend
+static uint32_t div32(uint32_t a, uint32_t b) {
+    if (((a | b) >> 16) == 0) return (uint16_t) a / (uint16_t) b;
+    return a / b;
+}
+static uint32_t rem32(uint32_t a, uint32_t b) {
+    if (((a | b) >> 16) == 0) return (uint16_t) a % (uint16_t) b;
+    return a % b;
+}
+static int32_t idiv32(int32_t a, int32_t b) {
+    uint32_t x = div32(a < 0 ? -(uint32_t) a : (uint32_t) a,
+                       b < 0 ? -(uint32_t) b : (uint32_t) b);
+    return (a < 0) != (b < 0) ? -x : x;
+}
+static int32_t irem32(int32_t a, int32_t b) {
+    uint32_t x = rem32(a < 0 ? -(uint32_t) a : (uint32_t) a,
+                       b < 0 ? -(uint32_t) b : (uint32_t) b);
+    return a < 0 ? -x : x;
+}
+
+// shift by whole bytes first, which are only moves, then a bit at a time.
+// count is 0 to 31
+static uint32_t shift_left32(uint32_t value, uint8_t count) {
+    if (count & 16) value <<= 16;
+    if (count & 8) value <<= 8;
+    for (count &= 7; count; count--) value <<= 1;
+    return value;
+}
+static uint32_t shift_right32(uint32_t value, uint8_t count) {
+    if (count & 16) value >>= 16;
+    if (count & 8) value >>= 8;
+    for (count &= 7; count; count--) value >>= 1;
+    return value;
+}
+static int32_t shift_right_arith32(int32_t value, uint8_t count) {
+    if (count & 16) value >>= 16;
+    if (count & 8) value >>= 8;
+    for (count &= 7; count; count--) value >>= 1;
+    return value;
+}
+
 #define CHECKED_ADD(_a, _b, _out) __builtin_add_overflow(_a, _b, _out)
 #define CHECKED_SUB(_a, _b, _out) __builtin_sub_overflow(_a, _b, _out)
 #define CHECKED_MUL(_a, _b, _out) __builtin_mul_overflow(_a, _b, _out)
+#define CHECKED_MUL32(_a, _b, _out) mul32(_a, _b, _out)
+#define CHECKED_IMUL32(_a, _b, _out) imul32(_a, _b, _out)
 
 #define OPER_DIV(_a, _b) ((_a) / (_b))
+#define OPER_DIV32(_a, _b) div32(_a, _b)
+#define OPER_IDIV32(_a, _b) idiv32(_a, _b)
 #define OPER_REM(_a, _b) ((_a) % (_b))
+#define OPER_REM32(_a, _b) rem32(_a, _b)
+#define OPER_IREM32(_a, _b) irem32(_a, _b)
 #define OPER_AND(_a, _b) ((_a) & (_b))
 #define OPER_XOR(_a, _b) ((_a) ^ (_b))
 #define OPER_OR(_a, _b) ((_a) | (_b))
 #define OPER_SHIFT_LEFT(_a, _b) ((_a) << (_b))
+#define OPER_SHIFT_LEFT32(_a, _b) shift_left32(_a, _b)
 #define OPER_SHIFT_RIGHT(_a, _b) ((_a) >> (_b))
-#define OPER_BIT_SET(_a, _b) ((_a) | (1 << (_b)))
-#define OPER_BIT_CLEAR(_a, _b) ((_a) & ~(1 << (_b)))
-
-#define ROTATE_LEFT(_size, _a, _b) (((_a) << (_b)) | ((_a) >> (((_size) * 8) - (_b))))
+#define OPER_SHIFT_RIGHT32(_a, _b) shift_right32(_a, _b)
+#define OPER_SHIFT_RIGHT_ARITH32(_a, _b) shift_right_arith32(_a, _b)
+#define OPER_BIT_SET(_a, _b) ((_a) | (1u << (_b)))
+#define OPER_BIT_SET32(_a, _b) ((_a) | shift_left32(1, _b))
+#define OPER_BIT_CLEAR(_a, _b) ((_a) & ~(1u << (_b)))
+#define OPER_BIT_CLEAR32(_a, _b) ((_a) & ~shift_left32(1, _b))
+
+#define ROTATE_LEFT(_size, _a, _b) (((_a) << (_b)) | ((_a) >> (-(_b) & ((_size) * 8 - 1))))
 #define ROTATE_LEFT8(_a, _b) ROTATE_LEFT(SIZE8, _a, _b)
 #define ROTATE_LEFT16(_a, _b) ROTATE_LEFT(SIZE16, _a, _b)
-#define ROTATE_LEFT32(_a, _b) ROTATE_LEFT(SIZE32, _a, _b)
-#define ROTATE_RIGHT(_size, _a, _b) (((_a) >> (_b)) | ((_a) << (((_size) * 8) - (_b))))
+#define ROTATE_LEFT32(_a, _b) (shift_left32(_a, _b) | shift_right32(_a, -(_b) & 31))
+#define ROTATE_RIGHT(_size, _a, _b) (((_a) >> (_b)) | ((_a) << (-(_b) & ((_size) * 8 - 1))))
 #define ROTATE_RIGHT8(_a, _b) ROTATE_RIGHT(SIZE8, _a, _b)
 #define ROTATE_RIGHT16(_a, _b) ROTATE_RIGHT(SIZE16, _a, _b)
-#define ROTATE_RIGHT32(_a, _b) ROTATE_RIGHT(SIZE32, _a, _b)
+#define ROTATE_RIGHT32(_a, _b) (shift_right32(_a, _b) | shift_left32(_a, -(_b) & 31))
 
 #define SOURCEMAP_IDENTITY(x) (x)
 #define SOURCEMAP_RELATIVE(x) (instr_base + (x))
@@ -638,33 +802,56 @@ static void vm_skipparam(vm_t *vm, uint32_t size, uint8_t prtype, uint8_t offset
     break;                                                                                  \
 }
 
-#define VM_IMPL_NOT(_size, _type, _vm_source_stay, _vm_target) { \
-    VM_PRELUDE_1(_size);                                         \
-    _type v = _vm_source_stay(vm, instr.source, instr.offset);   \
-    _type x = ~v;                                                \
-    _vm_target(vm, instr.source, x, instr.offset);               \
-    vm->flag_zero = x == 0;                                      \
-    break;                                                       \
+// the register a read-modify-write instruction updates, or NULL if the
+// operand is in memory. a register is found once and updated in place,
+// rather than decoding the operand again to write the result back
+static uint32_t *vm_local_operand(vm_t *vm, uint8_t prtype) {
+    if (prtype != TY_REG) return NULL;
+    return vm_findlocal(vm, vm_read8(vm, vm->pointer_instr_mut));
+}
+
+#define VM_OPERAND_GET(_type, _local, _vm_source_stay, _prtype) \
+    ((_local) ? (_type) *(_local) : (_type) _vm_source_stay(vm, _prtype, instr.offset))
+
+#define VM_OPERAND_SET(_size, _local, _vm_target, _prtype, _value) { \
+    if (_local) {                                                    \
+        vm->pointer_instr_mut += SIZE8;                              \
+        vm_local_set(_local, _value, _size);                         \
+    } else {                                                         \
+        _vm_target(vm, _prtype, _value, instr.offset);               \
+    }                                                                \
+}
+
+#define VM_IMPL_NOT(_size, _type, _vm_source_stay, _vm_target) {           \
+    VM_PRELUDE_1(_size);                                                   \
+    uint32_t *local = vm_local_operand(vm, instr.source);                  \
+    _type v = VM_OPERAND_GET(_type, local, _vm_source_stay, instr.source); \
+    _type x = ~v;                                                          \
+    VM_OPERAND_SET(_size, local, _vm_target, instr.source, x);             \
+    vm->flag_zero = x == 0;                                                \
+    break;                                                                 \
 }
 
-#define VM_IMPL_INC(_size, _type, _vm_source_stay, _vm_target, _oper) { \
-    VM_PRELUDE_1(_size);                                                \
-    _type v = _vm_source_stay(vm, instr.source, instr.offset);          \
-    _type x;                                                            \
-    bool carry = _oper(v, 1 << instr.target, &x);                       \
-    _vm_target(vm, instr.source, x, instr.offset);                      \
-    vm->flag_carry = carry;                                             \
-    vm->flag_zero = x == 0;                                             \
-    break;                                                              \
+#define VM_IMPL_INC(_size, _type, _vm_source_stay, _vm_target, _oper) {    \
+    VM_PRELUDE_1(_size);                                                   \
+    uint32_t *local = vm_local_operand(vm, instr.source);                  \
+    _type v = VM_OPERAND_GET(_type, local, _vm_source_stay, instr.source); \
+    _type x;                                                               \
+    bool carry = _oper(v, 1 << instr.target, &x);                          \
+    VM_OPERAND_SET(_size, local, _vm_target, instr.source, x);             \
+    vm->flag_carry = carry;                                                \
+    vm->flag_zero = x == 0;                                                \
+    break;                                                                 \
 }
 
 #define VM_IMPL_ADD(_size, _type, _type_target, _vm_source, _vm_source_stay, _vm_target, _oper) { \
     VM_PRELUDE_2(_size);                                                                          \
     _type a = (_type) _vm_source(vm, instr.source, instr.offset);                                 \
-    _type b = (_type) _vm_source_stay(vm, instr.target, instr.offset);                            \
+    uint32_t *local = vm_local_operand(vm, instr.target);                                         \
+    _type b = VM_OPERAND_GET(_type, local, _vm_source_stay, instr.target);                        \
     _type x;                                                                                      \
     bool carry = _oper(b, a, &x);                                                                 \
-    _vm_target(vm, instr.target, (_type_target) x, instr.offset);                                 \
+    VM_OPERAND_SET(_size, local, _vm_target, instr.target, (_type_target) x);                     \
     vm->flag_carry = carry;                                                                       \
     vm->flag_zero = x == 0;                                                                       \
     break;                                                                                        \
@@ -673,33 +860,36 @@ static void vm_skipparam(vm_t *vm, uint32_t size, uint8_t prtype, uint8_t offset
 #define VM_IMPL_AND(_size, _type, _type_target, _vm_source, _vm_source_stay, _vm_target, _oper) { \
     VM_PRELUDE_2(_size);                                                                          \
     _type a = (_type) _vm_source(vm, instr.source, instr.offset);                                 \
-    _type b = (_type) _vm_source_stay(vm, instr.target, instr.offset);                            \
+    uint32_t *local = vm_local_operand(vm, instr.target);                                         \
+    _type b = VM_OPERAND_GET(_type, local, _vm_source_stay, instr.target);                        \
     _type x = _oper(b, a);                                                                        \
-    _vm_target(vm, instr.target, (_type_target) x, instr.offset);                                 \
+    VM_OPERAND_SET(_size, local, _vm_target, instr.target, (_type_target) x);                     \
     vm->flag_zero = x == 0;                                                                       \
     break;                                                                                        \
 }
 
-#define VM_IMPL_SHIFT(_size, _type, _type_target, _vm_source, _vm_source_stay, _vm_target, _oper){\
-    VM_PRELUDE_BIT(_size);                                                                        \
-    _type a = (_type) vm_source8(vm, instr.source, instr.offset);                                 \
-    _type b = (_type) _vm_source_stay(vm, instr.target, instr.offset);                            \
-    _type x = _oper(b, a);                                                                        \
-    _vm_target(vm, instr.target, (_type_target) x, instr.offset);                                 \
-    vm->flag_zero = x == 0;                                                                       \
-    break;                                                                                        \
+#define VM_IMPL_SHIFT(_size, _type, _type_target, _vm_source, _vm_source_stay, _vm_target, _oper) { \
+    VM_PRELUDE_BIT(_size);                                                                          \
+    uint8_t a = vm_source8(vm, instr.source, instr.offset) & (_size * 8 - 1);                       \
+    uint32_t *local = vm_local_operand(vm, instr.target);                                           \
+    _type b = VM_OPERAND_GET(_type, local, _vm_source_stay, instr.target);                          \
+    _type x = _oper(b, a);                                                                          \
+    VM_OPERAND_SET(_size, local, _vm_target, instr.target, (_type_target) x);                       \
+    vm->flag_zero = x == 0;                                                                         \
+    break;                                                                                          \
 }
 
 #define VM_IMPL_DIV(_size, _type, _type_target, _vm_source, _vm_source_stay, _vm_target, _oper) { \
     VM_PRELUDE_2(_size);                                                                          \
     _type a = (_type) _vm_source(vm, instr.source, instr.offset);                                 \
-    _type b = (_type) _vm_source_stay(vm, instr.target, instr.offset);                            \
+    uint32_t *local = vm_local_operand(vm, instr.target);                                         \
+    _type b = VM_OPERAND_GET(_type, local, _vm_source_stay, instr.target);                        \
     if (a == 0) {                                                                                 \
         vm_panic(vm, FOX32_ERR_DIVZERO);                                                          \
         break;                                                                                    \
     }                                                                                             \
     _type x = _oper(b, a);                                                                        \
-    _vm_target(vm, instr.target, (_type_target) x, instr.offset);                                 \
+    VM_OPERAND_SET(_size, local, _vm_target, instr.target, (_type_target) x);                     \
     vm->flag_zero = x == 0;                                                                       \
     break;                                                                                        \
 }
@@ -714,20 +904,23 @@ static void vm_skipparam(vm_t *vm, uint32_t size, uint8_t prtype, uint8_t offset
     break;                                                \
 }
 
-#define VM_IMPL_BTS(_size, _type, _vm_source) {           \
-    VM_PRELUDE_BIT(_size);                                \
-    _type a = vm_source8(vm, instr.source, instr.offset); \
-    _type b = _vm_source(vm, instr.target, instr.offset); \
-    _type x = b & (1 << a);                               \
-    vm->flag_zero = x == 0;                               \
-    break;                                                \
+#define VM_IMPL_BTS(_size, _type, _vm_source) {                               \
+    VM_PRELUDE_BIT(_size);                                                    \
+    uint8_t a = vm_source8(vm, instr.source, instr.offset) & (_size * 8 - 1); \
+    _type b = _vm_source(vm, instr.target, instr.offset);                     \
+    _type x = b & (_size == SIZE32 ? shift_left32(1, a) : 1u << a);           \
+    vm->flag_zero = x == 0;                                                   \
+    break;                                                                    \
 }
 
 static void vm_execute(vm_t *vm) {
+    PROFILE_START();
     uint32_t instr_base = vm->pointer_instr;
     uint16_t instr_raw = vm_read16(vm, instr_base);
+    TRACE_INSTRUCTION(instr_base, instr_raw);
 
     asm_instr_t instr = asm_instr_from(instr_raw);
+    PROFILE_OPCODE(instr.opcode, instr.target, instr.source);
 
     vm->pointer_instr_mut = instr_base + SIZE16;
 
@@ -858,23 +1051,23 @@ static void vm_execute(vm_t *vm) {
         case OP(SZ_WORD, OP_SUB): VM_IMPL_ADD(SIZE32, uint32_t, uint32_t, vm_source32, vm_source32_stay, vm_target32, CHECKED_SUB);
         case OP(SZ_BYTE, OP_MUL): VM_IMPL_ADD(SIZE8, uint8_t, uint8_t, vm_source8, vm_source8_stay, vm_target8, CHECKED_MUL);
         case OP(SZ_HALF, OP_MUL): VM_IMPL_ADD(SIZE16, uint16_t, uint16_t, vm_source16, vm_source16_stay, vm_target16, CHECKED_MUL);
-        case OP(SZ_WORD, OP_MUL): VM_IMPL_ADD(SIZE32, uint32_t, uint32_t, vm_source32, vm_source32_stay, vm_target32, CHECKED_MUL);
+        case OP(SZ_WORD, OP_MUL): VM_IMPL_ADD(SIZE32, uint32_t, uint32_t, vm_source32, vm_source32_stay, vm_target32, CHECKED_MUL32);
         case OP(SZ_BYTE, OP_IMUL): VM_IMPL_ADD(SIZE8, int8_t, uint8_t, vm_source8, vm_source8_stay, vm_target8, CHECKED_MUL);
         case OP(SZ_HALF, OP_IMUL): VM_IMPL_ADD(SIZE16, int16_t, uint16_t, vm_source16, vm_source16_stay, vm_target16, CHECKED_MUL);
-        case OP(SZ_WORD, OP_IMUL): VM_IMPL_ADD(SIZE32, int32_t, uint32_t, vm_source32, vm_source32_stay, vm_target32, CHECKED_MUL);
+        case OP(SZ_WORD, OP_IMUL): VM_IMPL_ADD(SIZE32, int32_t, uint32_t, vm_source32, vm_source32_stay, vm_target32, CHECKED_IMUL32);
 
         case OP(SZ_BYTE, OP_DIV): VM_IMPL_DIV(SIZE8, uint8_t, uint8_t, vm_source8, vm_source8_stay, vm_target8, OPER_DIV);
         case OP(SZ_HALF, OP_DIV): VM_IMPL_DIV(SIZE16, uint16_t, uint16_t, vm_source16, vm_source16_stay, vm_target16, OPER_DIV);
-        case OP(SZ_WORD, OP_DIV): VM_IMPL_DIV(SIZE32, uint32_t, uint32_t, vm_source32, vm_source32_stay, vm_target32, OPER_DIV);
+        case OP(SZ_WORD, OP_DIV): VM_IMPL_DIV(SIZE32, uint32_t, uint32_t, vm_source32, vm_source32_stay, vm_target32, OPER_DIV32);
         case OP(SZ_BYTE, OP_REM): VM_IMPL_DIV(SIZE8, uint8_t, uint8_t, vm_source8, vm_source8_stay, vm_target8, OPER_REM);
         case OP(SZ_HALF, OP_REM): VM_IMPL_DIV(SIZE16, uint16_t, uint16_t, vm_source16, vm_source16_stay, vm_target16, OPER_REM);
-        case OP(SZ_WORD, OP_REM): VM_IMPL_DIV(SIZE32, uint32_t, uint32_t, vm_source32, vm_source32_stay, vm_target32, OPER_REM);
+        case OP(SZ_WORD, OP_REM): VM_IMPL_DIV(SIZE32, uint32_t, uint32_t, vm_source32, vm_source32_stay, vm_target32, OPER_REM32);
         case OP(SZ_BYTE, OP_IDIV): VM_IMPL_DIV(SIZE8, int8_t, uint8_t, vm_source8, vm_source8_stay, vm_target8, OPER_DIV);
         case OP(SZ_HALF, OP_IDIV): VM_IMPL_DIV(SIZE16, int16_t, uint16_t, vm_source16, vm_source16_stay, vm_target16, OPER_DIV);
-        case OP(SZ_WORD, OP_IDIV): VM_IMPL_DIV(SIZE32, int32_t, uint32_t, vm_source32, vm_source32_stay, vm_target32, OPER_DIV);
+        case OP(SZ_WORD, OP_IDIV): VM_IMPL_DIV(SIZE32, int32_t, uint32_t, vm_source32, vm_source32_stay, vm_target32, OPER_IDIV32);
         case OP(SZ_BYTE, OP_IREM): VM_IMPL_DIV(SIZE8, int8_t, uint8_t, vm_source8, vm_source8_stay, vm_target8, OPER_REM);
         case OP(SZ_HALF, OP_IREM): VM_IMPL_DIV(SIZE16, int16_t, uint16_t, vm_source16, vm_source16_stay, vm_target16, OPER_REM);
-        case OP(SZ_WORD, OP_IREM): VM_IMPL_DIV(SIZE32, int32_t, uint32_t, vm_source32, vm_source32_stay, vm_target32, OPER_REM);
+        case OP(SZ_WORD, OP_IREM): VM_IMPL_DIV(SIZE32, int32_t, uint32_t, vm_source32, vm_source32_stay, vm_target32, OPER_IREM32);
 
         case OP(SZ_BYTE, OP_AND): VM_IMPL_AND(SIZE8, uint8_t, uint8_t, vm_source8, vm_source8_stay, vm_target8, OPER_AND);
         case OP(SZ_HALF, OP_AND): VM_IMPL_AND(SIZE16, uint16_t, uint16_t, vm_source16, vm_source16_stay, vm_target16, OPER_AND);
@@ -888,13 +1081,13 @@ static void vm_execute(vm_t *vm) {
 
         case OP(SZ_BYTE, OP_SLA): VM_IMPL_SHIFT(SIZE8, uint8_t, uint8_t, vm_source8, vm_source8_stay, vm_target8, OPER_SHIFT_LEFT);
         case OP(SZ_HALF, OP_SLA): VM_IMPL_SHIFT(SIZE16, uint16_t, uint16_t, vm_source16, vm_source16_stay, vm_target16, OPER_SHIFT_LEFT);
-        case OP(SZ_WORD, OP_SLA): VM_IMPL_SHIFT(SIZE32, uint32_t, uint32_t, vm_source32, vm_source32_stay, vm_target32, OPER_SHIFT_LEFT);
+        case OP(SZ_WORD, OP_SLA): VM_IMPL_SHIFT(SIZE32, uint32_t, uint32_t, vm_source32, vm_source32_stay, vm_target32, OPER_SHIFT_LEFT32);
         case OP(SZ_BYTE, OP_SRL): VM_IMPL_SHIFT(SIZE8, uint8_t, uint8_t, vm_source8, vm_source8_stay, vm_target8, OPER_SHIFT_RIGHT);
         case OP(SZ_HALF, OP_SRL): VM_IMPL_SHIFT(SIZE16, uint16_t, uint16_t, vm_source16, vm_source16_stay, vm_target16, OPER_SHIFT_RIGHT);
-        case OP(SZ_WORD, OP_SRL): VM_IMPL_SHIFT(SIZE32, uint32_t, uint32_t, vm_source32, vm_source32_stay, vm_target32, OPER_SHIFT_RIGHT);
+        case OP(SZ_WORD, OP_SRL): VM_IMPL_SHIFT(SIZE32, uint32_t, uint32_t, vm_source32, vm_source32_stay, vm_target32, OPER_SHIFT_RIGHT32);
         case OP(SZ_BYTE, OP_SRA): VM_IMPL_SHIFT(SIZE8, int8_t, uint8_t, vm_source8, vm_source8_stay, vm_target8, OPER_SHIFT_RIGHT);
         case OP(SZ_HALF, OP_SRA): VM_IMPL_SHIFT(SIZE16, int16_t, uint16_t, vm_source16, vm_source16_stay, vm_target16, OPER_SHIFT_RIGHT);
-        case OP(SZ_WORD, OP_SRA): VM_IMPL_SHIFT(SIZE32, int32_t, uint32_t, vm_source32, vm_source32_stay, vm_target32, OPER_SHIFT_RIGHT);
+        case OP(SZ_WORD, OP_SRA): VM_IMPL_SHIFT(SIZE32, int32_t, uint32_t, vm_source32, vm_source32_stay, vm_target32, OPER_SHIFT_RIGHT_ARITH32);
 
         case OP(SZ_BYTE, OP_ROL): VM_IMPL_SHIFT(SIZE8, uint8_t, uint8_t, vm_source8, vm_source8_stay, vm_target8, ROTATE_LEFT8);
         case OP(SZ_HALF, OP_ROL): VM_IMPL_SHIFT(SIZE16, uint16_t, uint16_t, vm_source16, vm_source16_stay, vm_target16, ROTATE_LEFT16);
@@ -905,10 +1098,10 @@ static void vm_execute(vm_t *vm) {
 
         case OP(SZ_BYTE, OP_BSE): VM_IMPL_SHIFT(SIZE8, uint8_t, uint8_t, vm_source8, vm_source8_stay, vm_target8, OPER_BIT_SET);
         case OP(SZ_HALF, OP_BSE): VM_IMPL_SHIFT(SIZE16, uint16_t, uint16_t, vm_source16, vm_source16_stay, vm_target16, OPER_BIT_SET);
-        case OP(SZ_WORD, OP_BSE): VM_IMPL_SHIFT(SIZE32, uint32_t, uint32_t, vm_source32, vm_source32_stay, vm_target32, OPER_BIT_SET);
+        case OP(SZ_WORD, OP_BSE): VM_IMPL_SHIFT(SIZE32, uint32_t, uint32_t, vm_source32, vm_source32_stay, vm_target32, OPER_BIT_SET32);
         case OP(SZ_BYTE, OP_BCL): VM_IMPL_SHIFT(SIZE8, uint8_t, uint8_t, vm_source8, vm_source8_stay, vm_target8, OPER_BIT_CLEAR);
         case OP(SZ_HALF, OP_BCL): VM_IMPL_SHIFT(SIZE16, uint16_t, uint16_t, vm_source16, vm_source16_stay, vm_target16, OPER_BIT_CLEAR);
-        case OP(SZ_WORD, OP_BCL): VM_IMPL_SHIFT(SIZE32, uint32_t, uint32_t, vm_source32, vm_source32_stay, vm_target32, OPER_BIT_CLEAR);
+        case OP(SZ_WORD, OP_BCL): VM_IMPL_SHIFT(SIZE32, uint32_t, uint32_t, vm_source32, vm_source32_stay, vm_target32, OPER_BIT_CLEAR32);
 
         case OP(SZ_BYTE, OP_CMP): VM_IMPL_CMP(SIZE8, uint8_t, vm_source8);
         case OP(SZ_HALF, OP_CMP): VM_IMPL_CMP(SIZE16, uint16_t, vm_source16);
@@ -946,6 +1139,7 @@ static void vm_execute(vm_t *vm) {
     }
 
     vm->pointer_instr = vm->pointer_instr_mut;
+    PROFILE_END(instr.opcode);
 }
 
 static err_t vm_step(vm_t *vm) {
@@ -964,11 +1158,15 @@ static err_t vm_resume(vm_t *vm, uint32_t count, uint32_t *executed) {
 
     uint32_t remaining = count;
     while (!vm->halted && !vm->soft_halted && remaining > 0) {
+        PC_SAMPLE(vm->pointer_instr);
         vm_execute(vm);
+        TRACE_SERVICE(vm);
         remaining -= 1;
         *executed += 1;
     }
 
+    PERF_COUNT(PERF_INSTRUCTIONS, count - remaining);
+
     if (vm->soft_halted) {
         *executed = count;
     }
@@ -1005,6 +1203,7 @@ static fox32_err_t vm_raise(vm_t *vm, uint16_t vector) {
     } else {
         // if this is an interrupt, push the vector
         vm_push32(vm, (uint32_t) vector);
+        PERF_COUNT(PERF_INTERRUPTS, 1);
     }
 
     vm->pointer_instr = pointer_handler;
@@ -1073,6 +1272,74 @@ static fox32_err_t vm_safepop_word(vm_t *vm, uint32_t *value) {
     VM_SAFEPOP_BODY(vm_pop32)
 }
 
+static fox32_err_t vm_saferead_word(vm_t *vm, uint32_t address, uint32_t *value) {
+    *value = 0;
+    if (setjmp(vm->panic_jmp) != 0) {
+        return vm->panic_err;
+    }
+    *value = vm_read32(vm, address);
+    return FOX32_ERR_OK;
+}
+static fox32_err_t vm_safewrite_word(vm_t *vm, uint32_t address, uint32_t value) {
+    if (setjmp(vm->panic_jmp) != 0) {
+        return vm->panic_err;
+    }
+    vm_write32(vm, address, value);
+    return FOX32_ERR_OK;
+}
+
+// feed guest memory to sink, reading RAM a page at a time with sequential
+// SPI reads. this can be called from an io handler in the middle of an
+// instruction, so the instruction's panic_jmp is put back afterwards
+static fox32_err_t vm_safestream(vm_t *vm, uint32_t address, uint32_t length, fox32_sink_t *sink) {
+    jmp_buf panic_jmp;
+    memcpy(panic_jmp, vm->panic_jmp, sizeof(jmp_buf));
+    if (setjmp(vm->panic_jmp) != 0) {
+        memcpy(vm->panic_jmp, panic_jmp, sizeof(jmp_buf));
+        return vm->panic_err;
+    }
+
+    if (vm->is_consecutive_read) {
+        vm->is_consecutive_read = false;
+        SpiRamSeqReadEnd();
+    }
+
+    while (length > 0) {
+        if (address >= FOX32_MEMORY_RAM) {
+            // ROM, or a fault
+            sink(vm_read8(vm, address));
+            address++;
+            length--;
+            continue;
+        }
+
+        uint16_t page = address / FOX32_PAGE_SIZE;
+        uint32_t offset = address % FOX32_PAGE_SIZE;
+        uint32_t chunk = FOX32_PAGE_SIZE - offset;
+        if (chunk > length) chunk = length;
+        uint8_t physical_page = find_physical_page(vm, page);
+        if (physical_page == 0xFF) {
+            load_page_in(vm, page);
+            physical_page = find_physical_page(vm, page);
+        }
+        uint32_t physical_address = ((uint32_t) physical_page * (uint32_t) FOX32_PAGE_SIZE) + offset;
+        u8 bank = 0;
+        if (physical_address > 0xFFFF) {
+            bank = 1;
+            physical_address &= 0xFFFF;
+        }
+        SpiRamSeqReadStart(bank, (u16) physical_address);
+        for (uint32_t i = 0; i < chunk; i++) sink(SpiRamSeqReadU8());
+        SpiRamSeqReadEnd();
+        PERF_COUNT(PERF_SPI_BYTES, chunk);
+        address += chunk;
+        length -= chunk;
+    }
+
+    memcpy(vm->panic_jmp, panic_jmp, sizeof(jmp_buf));
+    return FOX32_ERR_OK;
+}
+
 void fox32_init(fox32_vm_t *vm) {
     vm_init(vm);
 }
@@ -1106,3 +1373,12 @@ fox32_err_t fox32_pop_half(fox32_vm_t *vm, uint16_t *value) {
 fox32_err_t fox32_pop_word(fox32_vm_t *vm, uint32_t *value) {
     return vm_safepop_word(vm, value);
 }
+fox32_err_t fox32_read_word(fox32_vm_t *vm, uint32_t address, uint32_t *value) {
+    return vm_saferead_word(vm, address, value);
+}
+fox32_err_t fox32_write_word(fox32_vm_t *vm, uint32_t address, uint32_t value) {
+    return vm_safewrite_word(vm, address, value);
+}
+fox32_err_t fox32_stream(fox32_vm_t *vm, uint32_t address, uint32_t length, fox32_sink_t *sink) {
+    return vm_safestream(vm, address, length, sink);
+}
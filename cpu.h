@@ -5,7 +5,9 @@
 #include <stdbool.h>
 #include <setjmp.h>
 
-#define FOX32_MEMORY_RAM 0x00100000 //  1 MiB
+#ifndef FOX32_MEMORY_RAM
+#define FOX32_MEMORY_RAM 0x00100000 //  1 MiB, swap limits this to 16 MiB
+#endif
 #define FOX32_MEMORY_ROM 0x00004000 // 16 KiB
 #define FOX32_MEMORY_ROM_START 0xF0000000
 
@@ -14,6 +16,36 @@
 
 #define FOX32_POINTER_INTERRUPTVECS 0x00000000
 
+#ifndef FOX32_PAGE_SIZE
+#define FOX32_PAGE_SIZE 4096
+#endif
+#if FOX32_PAGE_SIZE != 512 && FOX32_PAGE_SIZE != 1024 && FOX32_PAGE_SIZE != 2048 && FOX32_PAGE_SIZE != 4096
+#error "FOX32_PAGE_SIZE must be 512, 1024, 2048 or 4096"
+#endif
+#define FOX32_SWAP_SECTORS_PER_PAGE (FOX32_PAGE_SIZE / 512)
+
+#define FOX32_PAGES (FOX32_MEMORY_RAM / FOX32_PAGE_SIZE)
+// 128 KiB of SPI RAM. 0xFF means "not in memory", so with 512 byte pages the
+// last physical page goes unused
+#if 0x20000 / FOX32_PAGE_SIZE > 255
+#define FOX32_PHYSICAL_PAGES 255
+#else
+#define FOX32_PHYSICAL_PAGES (0x20000 / FOX32_PAGE_SIZE)
+#endif
+
+// pages are mapped to physical pages through a two level table. each leaf
+// table maps FOX32_PAGE_LEAF_ENTRIES consecutive pages, and leaves are only
+// allocated for parts of the address space that currently have pages in memory
+#define FOX32_PAGE_LEAF_ENTRIES 32
+#define FOX32_PAGE_DIRECTORY_ENTRIES (FOX32_PAGES / FOX32_PAGE_LEAF_ENTRIES)
+#ifndef FOX32_PAGE_LEAF_COUNT
+#if FOX32_PAGE_DIRECTORY_ENTRIES < 12
+#define FOX32_PAGE_LEAF_COUNT FOX32_PAGE_DIRECTORY_ENTRIES
+#else
+#define FOX32_PAGE_LEAF_COUNT 12
+#endif
+#endif
+
 #define FOX32_REGISTER_LOOP 31
 #define FOX32_REGISTER_COUNT 32
 
@@ -36,6 +68,7 @@ typedef enum {
 
 const char *fox32_strerr(fox32_err_t err);
 
+typedef void fox32_sink_t(uint8_t value);
 typedef int fox32_io_read_t(void *user, uint32_t *value, uint32_t port);
 typedef int fox32_io_write_t(void *user, uint32_t value, uint32_t port);
 
@@ -62,9 +95,12 @@ typedef struct {
     bool mmu_enabled;
     bool is_consecutive_read;
     uint32_t previous_read_address;
-    uint8_t page_is_in_memory_bitmap[32];
-    uint8_t physical_memory_bitmap[4];
-    uint8_t page_on_disk_is_at[256];
+    uint8_t physical_memory_bitmap[(FOX32_PHYSICAL_PAGES + 7) / 8];
+    uint8_t physical_memory_dirty_bitmap[(FOX32_PHYSICAL_PAGES + 7) / 8];
+    uint16_t physical_page_holds[FOX32_PHYSICAL_PAGES]; // 0xFFFF if free
+    uint8_t physical_page_directory[FOX32_PAGE_DIRECTORY_ENTRIES]; // 0xFF if no leaf
+    uint16_t physical_page_leaf_owner[FOX32_PAGE_LEAF_COUNT]; // 0xFFFF if free
+    uint8_t physical_page_leaves[FOX32_PAGE_LEAF_COUNT][FOX32_PAGE_LEAF_ENTRIES]; // 0xFF if not in memory
 
     jmp_buf panic_jmp;
     fox32_err_t panic_err;
@@ -90,3 +126,7 @@ fox32_err_t fox32_push_word(fox32_vm_t *vm, uint32_t value);
 fox32_err_t fox32_pop_byte(fox32_vm_t *vm, uint8_t *value);
 fox32_err_t fox32_pop_half(fox32_vm_t *vm, uint16_t *value);
 fox32_err_t fox32_pop_word(fox32_vm_t *vm, uint32_t *value);
+
+fox32_err_t fox32_read_word(fox32_vm_t *vm, uint32_t address, uint32_t *value);
+fox32_err_t fox32_write_word(fox32_vm_t *vm, uint32_t address, uint32_t value);
+fox32_err_t fox32_stream(fox32_vm_t *vm, uint32_t address, uint32_t length, fox32_sink_t *sink);
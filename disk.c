@@ -14,6 +14,11 @@
 
 #include "cpu.h"
 #include "disk.h"
+#include "irq.h"
+#include "perf.h"
+#include "snapshot.h"
+#include "timer.h"
+#include "trace.h"
 
 sdc_struct_t sd_struct;
 disk_controller_t disk_controller;
@@ -21,6 +26,17 @@ uint8_t disk_buffer[512];
 
 extern fox32_vm_t vm;
 
+// background cleaner state, see write_back_dirty_pages()
+static uint8_t cleaning_physical_page = 0xFF;
+static uint8_t cleaning_sector = 0;
+
+// next physical page to consider for eviction
+static uint8_t evict_hand = 0;
+// next leaf table to consider for eviction
+static uint8_t evict_leaf_hand = 0;
+// page that must not be evicted while a disk transfer is set up
+static uint16_t pinned_page = 0xFFFF;
+
 static uint8_t find_first_clear(uint8_t byte) {
     if (byte == 0xFF) return 0xFF;
     uint8_t first_clear = 0;
@@ -31,6 +47,62 @@ static uint8_t find_first_clear(uint8_t byte) {
     return first_clear;
 }
 
+static bool is_physical_page_dirty(fox32_vm_t *vm, uint8_t physical_page) {
+    return vm->physical_memory_dirty_bitmap[physical_page / 8] & (1 << (physical_page % 8));
+}
+
+// returns FOX32_PHYSICAL_PAGES if every page is clean
+static uint8_t find_dirty_page(fox32_vm_t *vm) {
+    uint8_t physical_page;
+    for (physical_page = 0; physical_page < FOX32_PHYSICAL_PAGES; physical_page++) {
+        if (is_physical_page_dirty(vm, physical_page)) break;
+    }
+    return physical_page;
+}
+
+static void sd_read_sector(void) {
+    FS_Read_Sector(&sd_struct);
+    PERF_COUNT(PERF_SD_SECTORS_READ, 1);
+}
+
+static void sd_write_sector(void) {
+    FS_Write_Sector(&sd_struct);
+    PERF_COUNT(PERF_SD_SECTORS_WRITTEN, 1);
+}
+
+static void seek_swap(uint16_t page, uint8_t sector) {
+    FS_Set_Pos(&sd_struct, disk_controller.disks[0].swap_begin);
+    for (uint32_t i = 0; i < (uint32_t) page * FOX32_SWAP_SECTORS_PER_PAGE + sector; i++)
+        FS_Next_Sector(&sd_struct);
+}
+
+static void write_swap_sector(uint8_t physical_page, uint8_t sector) {
+    snapshot_invalidate();
+    uint32_t physical_address = ((uint32_t) physical_page * (uint32_t) FOX32_PAGE_SIZE) + ((uint32_t) sector * 512);
+    uint8_t physical_bank = physical_address > 0xFFFF ? 1 : 0;
+    physical_address &= 0xFFFF;
+    SpiRamReadInto(physical_bank, physical_address, disk_buffer, 512);
+    PERF_COUNT(PERF_SPI_BYTES, 512);
+    sd_write_sector();
+}
+
+// pick a physical page to evict, preferring ones that are already clean
+static uint8_t choose_victim(fox32_vm_t *vm) {
+    for (uint8_t i = 0; i < FOX32_PHYSICAL_PAGES; i++) {
+        uint8_t physical_page = (evict_hand + i) % FOX32_PHYSICAL_PAGES;
+        if (vm->physical_page_holds[physical_page] == pinned_page) continue;
+        if (!is_physical_page_dirty(vm, physical_page) && physical_page != cleaning_physical_page) {
+            evict_hand = (physical_page + 1) % FOX32_PHYSICAL_PAGES;
+            return physical_page;
+        }
+    }
+    if (vm->physical_page_holds[evict_hand] == pinned_page)
+        evict_hand = (evict_hand + 1) % FOX32_PHYSICAL_PAGES;
+    uint8_t physical_page = evict_hand;
+    evict_hand = (evict_hand + 1) % FOX32_PHYSICAL_PAGES;
+    return physical_page;
+}
+
 void flush_physical_page_out(fox32_vm_t *vm, uint8_t physical_page) {
     if (vm->is_consecutive_read) {
         vm->is_consecutive_read = false;
@@ -42,112 +114,214 @@ void flush_physical_page_out(fox32_vm_t *vm, uint8_t physical_page) {
     SetBorderColor(0xF0);
 
     // find the page that corresponds to this physical page
-    // FIXME: optimize this better?
-    uint16_t page = 0xFFFF;
-    for (uint16_t i = 0; i < 256; i++) {
-        if (vm->page_on_disk_is_at[i] == physical_page) {
-            page = i;
-            break;
-        }
-    }
+    uint16_t page = vm->physical_page_holds[physical_page];
     if (page == 0xFFFF) {
         Print(0, 0, PSTR("page not found?"));
         SetBorderColor(0xBF);
         while (true);
     }
-    FS_Set_Pos(&sd_struct, disk_controller.disks[0].swap_begin);
-    for (uint16_t i = 0; i < page * 8; i++)
-        FS_Next_Sector(&sd_struct);
+
+    // clean pages already match swap, so only dirty ones need writing back.
+    // a page the cleaner is partway through still counts as dirty
+    PERF_COUNT(PERF_EVICTIONS, 1);
+    if (is_physical_page_dirty(vm, physical_page) || physical_page == cleaning_physical_page) {
+        PERF_COUNT(PERF_WRITEBACKS, 1);
+        seek_swap(page, 0);
+        for (uint8_t j = 0; j < FOX32_SWAP_SECTORS_PER_PAGE; j++) {
+            write_swap_sector(physical_page, j);
+            FS_Next_Sector(&sd_struct);
+        }
+    }
+    if (physical_page == cleaning_physical_page)
+        cleaning_physical_page = 0xFF;
 
     // mark it as free
     vm->physical_memory_bitmap[physical_page / 8] &= ~(1 << (physical_page % 8));
-    vm->page_is_in_memory_bitmap[page / 8] &= ~(1 << (page % 8));
-    uint32_t physical_address = (uint32_t) physical_page * (uint32_t) 4096;
+    vm->physical_memory_dirty_bitmap[physical_page / 8] &= ~(1 << (physical_page % 8));
+    vm->physical_page_holds[physical_page] = 0xFFFF;
 
-    uint8_t physical_bank = 0;
-    for (uint8_t j = 0; j < 8; j++) { // 4096 / 512 = 8
-        if (physical_address > 0xFFFF) {
-            physical_bank = 1;
-            physical_address &= 0xFFFF;
+    // unmap it, and give the leaf table back once nothing in it is resident
+    uint16_t directory = page / FOX32_PAGE_LEAF_ENTRIES;
+    uint8_t leaf = vm->physical_page_directory[directory];
+    vm->physical_page_leaves[leaf][page % FOX32_PAGE_LEAF_ENTRIES] = 0xFF;
+    bool leaf_empty = true;
+    for (uint8_t i = 0; i < FOX32_PAGE_LEAF_ENTRIES; i++) {
+        if (vm->physical_page_leaves[leaf][i] != 0xFF) {
+            leaf_empty = false;
+            break;
         }
-        SpiRamReadInto(physical_bank, physical_address, disk_buffer, 512);
-        FS_Write_Sector(&sd_struct);
-        FS_Next_Sector(&sd_struct);
-        physical_address += 512;
     }
-
-    // NOTE; i think this means attempting to flush page 0 will break things. so dont do that
-    vm->page_on_disk_is_at[page] = 0;
+    if (leaf_empty) {
+        vm->physical_page_directory[directory] = 0xFF;
+        vm->physical_page_leaf_owner[leaf] = 0xFFFF;
+    }
 
     FS_Set_Pos(&sd_struct, old_pos);
     SetBorderColor(0x00);
 }
 
-void load_page_in(fox32_vm_t *vm, uint8_t page) {
+// find a leaf table for the directory entry covering this page, evicting
+// every page mapped by another leaf if they're all in use
+static uint8_t allocate_leaf(fox32_vm_t *vm, uint16_t page) {
+    uint16_t directory = page / FOX32_PAGE_LEAF_ENTRIES;
+    uint8_t leaf = vm->physical_page_directory[directory];
+    if (leaf != 0xFF) return leaf;
+
+    for (leaf = 0; leaf < FOX32_PAGE_LEAF_COUNT; leaf++) {
+        if (vm->physical_page_leaf_owner[leaf] == 0xFFFF) break;
+    }
+    if (leaf == FOX32_PAGE_LEAF_COUNT) {
+        leaf = evict_leaf_hand;
+        if (pinned_page != 0xFFFF && vm->physical_page_leaf_owner[leaf] == pinned_page / FOX32_PAGE_LEAF_ENTRIES)
+            leaf = (leaf + 1) % FOX32_PAGE_LEAF_COUNT;
+        evict_leaf_hand = (leaf + 1) % FOX32_PAGE_LEAF_COUNT;
+        for (uint8_t i = 0; i < FOX32_PAGE_LEAF_ENTRIES; i++) {
+            uint8_t physical_page = vm->physical_page_leaves[leaf][i];
+            if (physical_page != 0xFF) flush_physical_page_out(vm, physical_page);
+        }
+    }
+
+    memset(vm->physical_page_leaves[leaf], 0xFF, FOX32_PAGE_LEAF_ENTRIES);
+    vm->physical_page_leaf_owner[leaf] = directory;
+    vm->physical_page_directory[directory] = leaf;
+    return leaf;
+}
+
+void load_page_in(fox32_vm_t *vm, uint16_t page) {
     if (vm->is_consecutive_read) {
         vm->is_consecutive_read = false;
         SpiRamSeqReadEnd();
     }
 
     SetBorderColor(0xE0);
+    PERF_COUNT(PERF_PAGE_FAULTS, 1);
+    TRACE_PAGE_FAULT(page);
 
     // find the first free physical page
     uint8_t first_clear = 0xFF;
     uint16_t i;
-    bool flag = false;
-retry:
-    for (i = 0; i < 4; i++) {
+    for (i = 0; i < sizeof(vm->physical_memory_bitmap); i++) {
         first_clear = find_first_clear(vm->physical_memory_bitmap[i]);
         if (first_clear != 0xFF) break;
     }
+    if (first_clear != 0xFF && (i * 8) + first_clear >= FOX32_PHYSICAL_PAGES)
+        first_clear = 0xFF;
     // if first_clear == 0xFF, free up some memory
     if (first_clear == 0xFF) {
-        // TODO: smarter page flushing
-        for (uint8_t j = 0; j < 8; j++) {
-            flush_physical_page_out(vm, 20 + j);
-        }
+        uint8_t victim = choose_victim(vm);
+        flush_physical_page_out(vm, victim);
         SetBorderColor(0xE0);
-        i = 0; first_clear = 0xFF;
-        if (flag) {
-            Print(0, 0, PSTR("flushed but still no page?"));
-            SetBorderColor(0xBF);
-            while (true);
-        }
-        flag = true;
-        goto retry;
+        i = victim / 8;
+        first_clear = victim % 8;
     }
+    uint8_t physical_page = (i * 8) + first_clear;
+
+    // this has to come after eviction, which can give leaf tables back
+    uint8_t leaf = allocate_leaf(vm, page);
+
+    uint32_t old_pos = FS_Get_Pos(&sd_struct);
 
     // mark it as used
-    vm->physical_memory_bitmap[i] |= (1 << first_clear);
-    vm->page_is_in_memory_bitmap[page / 8] |= (1 << (page % 8));
-    uint8_t physical_page = (i * 8) + first_clear;
-    uint32_t physical_address = (uint32_t) physical_page * (uint32_t) 4096;
+    vm->physical_memory_bitmap[physical_page / 8] |= (1 << (physical_page % 8));
+    vm->physical_page_holds[physical_page] = page;
+    uint32_t physical_address = (uint32_t) physical_page * (uint32_t) FOX32_PAGE_SIZE;
     // physical_address now equals the physical address to load this page to
 
-    FS_Set_Pos(&sd_struct, disk_controller.disks[0].swap_begin);
-    for (i = 0; i < page * 8; i++)
-        FS_Next_Sector(&sd_struct);
+    seek_swap(page, 0);
 
     uint8_t physical_bank = 0;
-    for (uint8_t j = 0; j < 8; j++) { // 4096 / 512 = 8
-        FS_Read_Sector(&sd_struct);
+    for (uint8_t j = 0; j < FOX32_SWAP_SECTORS_PER_PAGE; j++) {
+        sd_read_sector();
         if (physical_address > 0xFFFF) {
             physical_bank = 1;
             physical_address &= 0xFFFF;
         }
         SpiRamWriteFrom(physical_bank, physical_address, disk_buffer, 512);
+        PERF_COUNT(PERF_SPI_BYTES, 512);
         physical_address += 512;
         FS_Next_Sector(&sd_struct);
     }
 
     // save the physical location of this page
-    vm->page_on_disk_is_at[page] = physical_page;
+    vm->physical_page_leaves[leaf][page % FOX32_PAGE_LEAF_ENTRIES] = physical_page;
+    FS_Set_Pos(&sd_struct, old_pos);
     SetBorderColor(0x00);
 }
 
-void new_disk(const char *filename, size_t id) {
-    uint32_t t32;
-    t32 = FS_Find(&sd_struct,
+// write up to sector_budget dirty sectors back to swap. as idle work, it
+// also stops after any sector once the frame is over or an interrupt is
+// waiting
+static void write_back_dirty_pages(fox32_vm_t *vm, uint8_t sector_budget, bool idle) {
+    uint16_t start_frame = frame_count;
+
+    if (vm->is_consecutive_read) {
+        vm->is_consecutive_read = false;
+        SpiRamSeqReadEnd();
+    }
+
+    uint32_t old_pos = FS_Get_Pos(&sd_struct);
+    bool seeked = false;
+
+    SetBorderColor(0x38);
+
+    while (sector_budget--) {
+        if (cleaning_physical_page == 0xFF) {
+            // pick the next dirty physical page
+            uint8_t physical_page = find_dirty_page(vm);
+            if (physical_page == FOX32_PHYSICAL_PAGES) break;
+
+            // clear the dirty bit now, so a write made while the page is
+            // partway written back marks it dirty again
+            vm->physical_memory_dirty_bitmap[physical_page / 8] &= ~(1 << (physical_page % 8));
+            cleaning_physical_page = physical_page;
+            cleaning_sector = 0;
+            PERF_COUNT(PERF_WRITEBACKS, 1);
+            seeked = false;
+        }
+
+        if (!seeked) {
+            seek_swap(vm->physical_page_holds[cleaning_physical_page], cleaning_sector);
+            seeked = true;
+        }
+        write_swap_sector(cleaning_physical_page, cleaning_sector);
+        FS_Next_Sector(&sd_struct);
+
+        if (++cleaning_sector == FOX32_SWAP_SECTORS_PER_PAGE)
+            cleaning_physical_page = 0xFF;
+
+        if (idle && (frame_count != start_frame || irq_get_pending())) break;
+    }
+
+    FS_Set_Pos(&sd_struct, old_pos);
+    SetBorderColor(0x00);
+}
+
+// the background cleaner, for the rest of an idle frame
+void clean_dirty_pages(fox32_vm_t *vm, uint8_t sector_budget) {
+    write_back_dirty_pages(vm, sector_budget, true);
+}
+
+// write every dirty page back to swap, e.g. before powering off
+void flush_dirty_pages(fox32_vm_t *vm) {
+    while (cleaning_physical_page != 0xFF || find_dirty_page(vm) != FOX32_PHYSICAL_PAGES)
+        write_back_dirty_pages(vm, FOX32_SWAP_SECTORS_PER_PAGE, false);
+}
+
+// forget all paging and queue state for a warm reset. the disk images stay
+// as they are, so new_disk doesn't have to find them again
+void disk_reset(void) {
+    cleaning_physical_page = 0xFF;
+    cleaning_sector = 0;
+    evict_hand = 0;
+    evict_leaf_hand = 0;
+    pinned_page = 0xFFFF;
+    disk_controller.buffer_pointer = 0;
+    memset(&disk_controller.queue, 0, sizeof(disk_controller.queue));
+}
+
+// returns the first cluster of an 8.3 file in the root directory, or 0
+uint32_t find_file(const char *filename) {
+    return FS_Find(&sd_struct,
         ((u16)(filename[0])  << 8) |
         ((u16)(filename[1])      ),
         ((u16)(filename[2])  << 8) |
@@ -160,6 +334,10 @@ void new_disk(const char *filename, size_t id) {
         ((u16)(filename[9])      ),
         ((u16)(filename[10]) << 8) |
         ((u16)(0)               ));
+}
+
+void new_disk(const char *filename, size_t id) {
+    uint32_t t32 = find_file(filename);
     if (t32 == 0) {
         ClearVram();
         SetBorderColor(0xBF);
@@ -168,11 +346,11 @@ void new_disk(const char *filename, size_t id) {
     }
     FS_Select_Cluster(&sd_struct, t32);
     disk_controller.disks[id].file = t32;
-    disk_controller.disks[id].size = 0xF00000; // TODO: actual size?
+    disk_controller.disks[id].size = FOX32_SWAP_OFFSET; // TODO: actual size?
 
     // find and save the position of the swap data
-    // NOTE: this is hardcoded to put swap at 15 MiB into the file!!
-    for (uint32_t i = 0; i < 0xF00000 / 512; i++)
+    // NOTE: the image must have room for FOX32_MEMORY_RAM bytes of swap here!!
+    for (uint32_t i = 0; i < FOX32_SWAP_OFFSET / 512; i++)
         FS_Next_Sector(&sd_struct);
     disk_controller.disks[id].swap_begin = FS_Get_Pos(&sd_struct);
 }
@@ -200,32 +378,167 @@ void set_disk_sector(size_t id, uint64_t sector) {
     }
 }
 
+// make sure every page touched by a sector transfer at this address is
+// in memory. paging goes through disk_buffer, so do this before the transfer
+static void page_in_disk_buffer(uint32_t address) {
+    if (vm.is_consecutive_read) {
+        vm.is_consecutive_read = false;
+        SpiRamSeqReadEnd();
+    }
+
+    uint16_t first_page = address / FOX32_PAGE_SIZE;
+    uint16_t last_page = (address + 511) / FOX32_PAGE_SIZE;
+    if (find_physical_page(&vm, first_page) == 0xFF)
+        load_page_in(&vm, first_page);
+    if (find_physical_page(&vm, last_page) == 0xFF) {
+        pinned_page = first_page;
+        load_page_in(&vm, last_page);
+        pinned_page = 0xFFFF;
+    }
+}
+
 size_t read_disk_into_memory(size_t id) {
+    return read_disk_into_address(id, disk_controller.buffer_pointer);
+}
+
+size_t write_disk_from_memory(size_t id) {
+    return write_disk_from_address(id, disk_controller.buffer_pointer);
+}
+
+size_t read_disk_into_address(size_t id, uint32_t address) {
+    if (address > FOX32_MEMORY_RAM - 512) return 0;
+    page_in_disk_buffer(address);
     SetBorderColor(0x07);
-    FS_Read_Sector(&sd_struct);
-    uint8_t page = disk_controller.buffer_pointer / 4096;
-    uint32_t offset = disk_controller.buffer_pointer % 4096;
-    uint32_t physical_address = ((uint32_t) vm.page_on_disk_is_at[page] * (uint32_t) 4096) + offset;
-    uint8_t physical_bank = physical_address > 0xFFFF ? 1 : 0;
-    physical_address &= 0xFFFF;
-    SpiRamSeqWriteStart(physical_bank, physical_address);
-    SpiRamSeqWriteFrom(disk_buffer, 512);
-    SpiRamSeqWriteEnd();
+    sd_read_sector();
+    uint16_t done = 0;
+    while (done < 512) {
+        uint16_t page = address / FOX32_PAGE_SIZE;
+        uint32_t offset = address % FOX32_PAGE_SIZE;
+        uint16_t chunk = FOX32_PAGE_SIZE - offset;
+        if (chunk > 512 - done) chunk = 512 - done;
+        uint8_t physical_page = find_physical_page(&vm, page);
+        vm.physical_memory_dirty_bitmap[physical_page / 8] |= (1 << (physical_page % 8));
+        uint32_t physical_address = ((uint32_t) physical_page * (uint32_t) FOX32_PAGE_SIZE) + offset;
+        uint8_t physical_bank = physical_address > 0xFFFF ? 1 : 0;
+        physical_address &= 0xFFFF;
+        SpiRamSeqWriteStart(physical_bank, physical_address);
+        SpiRamSeqWriteFrom(disk_buffer + done, chunk);
+        SpiRamSeqWriteEnd();
+        PERF_COUNT(PERF_SPI_BYTES, chunk);
+        address += chunk;
+        done += chunk;
+    }
     SetBorderColor(0x00);
     return 512;
 }
 
-size_t write_disk_from_memory(size_t id) {
+size_t write_disk_from_address(size_t id, uint32_t address) {
+    if (address > FOX32_MEMORY_RAM - 512) return 0;
+    page_in_disk_buffer(address);
+    snapshot_invalidate();
     SetBorderColor(0x30);
-    uint8_t page = disk_controller.buffer_pointer / 4096;
-    uint32_t offset = disk_controller.buffer_pointer % 4096;
-    uint32_t physical_address = ((uint32_t) vm.page_on_disk_is_at[page] * (uint32_t) 4096) + offset;
-    uint8_t physical_bank = physical_address > 0xFFFF ? 1 : 0;
-    physical_address &= 0xFFFF;
-    SpiRamSeqReadStart(physical_bank, physical_address);
-    for (int i = 0; i < 512; i++) disk_buffer[i] = SpiRamSeqReadU8();
-    SpiRamSeqReadEnd();
-    FS_Write_Sector(&sd_struct);
+    uint16_t done = 0;
+    while (done < 512) {
+        uint16_t page = address / FOX32_PAGE_SIZE;
+        uint32_t offset = address % FOX32_PAGE_SIZE;
+        uint16_t chunk = FOX32_PAGE_SIZE - offset;
+        if (chunk > 512 - done) chunk = 512 - done;
+        uint32_t physical_address = ((uint32_t) find_physical_page(&vm, page) * (uint32_t) FOX32_PAGE_SIZE) + offset;
+        uint8_t physical_bank = physical_address > 0xFFFF ? 1 : 0;
+        physical_address &= 0xFFFF;
+        SpiRamSeqReadStart(physical_bank, physical_address);
+        for (uint16_t i = 0; i < chunk; i++) disk_buffer[done + i] = SpiRamSeqReadU8();
+        SpiRamSeqReadEnd();
+        PERF_COUNT(PERF_SPI_BYTES, chunk);
+        address += chunk;
+        done += chunk;
+    }
+    sd_write_sector();
     SetBorderColor(0x00);
     return 512;
 }
+
+// a ring the guest can't access can't be serviced any more, so turn the
+// queue off until the guest sets it up again
+static void disk_queue_stop(void) {
+    disk_controller.queue.entries = 0;
+    disk_controller.queue.busy = false;
+}
+
+static void disk_queue_complete(fox32_vm_t *vm, uint32_t status) {
+    disk_queue_t *queue = &disk_controller.queue;
+    uint32_t entry = queue->completion_ring + (uint32_t) (queue->completion_tail % queue->entries) * 8;
+    if (
+        (fox32_write_word(vm, entry, queue->tag) != FOX32_ERR_OK) ||
+        (fox32_write_word(vm, entry + 4, status) != FOX32_ERR_OK)
+    ) {
+        disk_queue_stop();
+        return;
+    }
+    queue->completion_tail++;
+    queue->submission_head++;
+    queue->busy = false;
+    irq_raise(IRQ_DISK);
+}
+
+// true if the queue has requests left to service
+bool disk_queue_busy(void) {
+    disk_queue_t *queue = &disk_controller.queue;
+    return queue->entries != 0 && (queue->busy || queue->submission_head != queue->submission_tail);
+}
+
+void disk_queue_service(fox32_vm_t *vm, uint8_t sector_budget) {
+    disk_queue_t *queue = &disk_controller.queue;
+    while (sector_budget && queue->entries != 0) {
+        if (!queue->busy) {
+            if (queue->submission_head == queue->submission_tail) break;
+            // wait for the guest if it hasn't made room for the completion
+            if ((uint8_t) (queue->completion_tail - queue->completion_head) >= queue->entries) break;
+
+            uint32_t entry = queue->submission_ring + (uint32_t) (queue->submission_head % queue->entries) * 16;
+            uint32_t header;
+            if (
+                (fox32_read_word(vm, entry, &header) != FOX32_ERR_OK) ||
+                (fox32_read_word(vm, entry + 4, &queue->sector) != FOX32_ERR_OK) ||
+                (fox32_read_word(vm, entry + 8, &queue->buffer) != FOX32_ERR_OK) ||
+                (fox32_read_word(vm, entry + 12, &queue->tag) != FOX32_ERR_OK)
+            ) {
+                disk_queue_stop();
+                break;
+            }
+            queue->command = header & 0xFF;
+            queue->id = (header >> 8) & 0xFF;
+            queue->count = header >> 16;
+            queue->progress = 0;
+            queue->busy = true;
+
+            if (
+                (queue->command != 1 && queue->command != 2) ||
+                (queue->id > 3) ||
+                (get_disk_size(queue->id) == 0) ||
+                (queue->buffer >= FOX32_MEMORY_RAM) ||
+                (queue->count > (FOX32_MEMORY_RAM - queue->buffer) / 512)
+            ) {
+                disk_queue_complete(vm, 0xFFFFFFFF);
+                continue;
+            }
+        }
+
+        if (queue->progress == queue->count) {
+            disk_queue_complete(vm, queue->count);
+            continue;
+        }
+
+        set_disk_sector(queue->id, queue->sector + queue->progress);
+        uint32_t address = queue->buffer + (uint32_t) queue->progress * 512;
+        if (queue->command == 1)
+            read_disk_into_address(queue->id, address);
+        else
+            write_disk_from_address(queue->id, address);
+        queue->progress++;
+        sector_budget--;
+
+        if (queue->progress == queue->count)
+            disk_queue_complete(vm, queue->count);
+    }
+}
@@ -2,22 +2,89 @@
 
 #include "cpu.h"
 
+// where the swap area starts in the disk image. everything before it is the
+// guest's disk, and the image needs FOX32_MEMORY_RAM bytes of room after it
+#ifndef FOX32_SWAP_OFFSET
+#define FOX32_SWAP_OFFSET 0xF00000 // 15 MiB
+#endif
+
+#define DISK_IMAGE_FILENAME "DISK0   IMG"
+
+// how many sectors the asynchronous disk queue may transfer between batches
+#ifndef DISK_QUEUE_SECTORS_PER_BATCH
+#define DISK_QUEUE_SECTORS_PER_BATCH 1
+#endif
+
+// the most swap sectors the background cleaner writes back per idle frame.
+// it also stops when the frame is over, see clean_dirty_pages()
+#ifndef CLEAN_SECTORS_PER_FRAME
+#define CLEAN_SECTORS_PER_FRAME 32
+#endif
+
 typedef struct {
     uint32_t file;
     uint64_t size;
     uint32_t swap_begin;
 } disk_t;
 
+// asynchronous disk queue. the guest keeps two rings in its own memory:
+//
+// submission entry, 16 bytes:
+//   0: command (1 = read, 2 = write), 1: disk id, 2: sector count (16 bits)
+//   4: first sector, 8: buffer pointer, 12: tag
+// completion entry, 8 bytes:
+//   0: tag, 4: sectors transferred, or 0xFFFFFFFF if the request failed
+//
+// ring indices are free-running 8 bit counters, the slot used is the index
+// modulo the ring size. the ring size must be a power of two, 128 at most.
+// if either ring can't be read or written the queue turns itself off, as
+// if the ring size had been set to zero
+typedef struct {
+    uint32_t submission_ring;
+    uint32_t completion_ring;
+    uint8_t entries;
+    uint8_t submission_head;
+    uint8_t submission_tail;
+    uint8_t completion_head;
+    uint8_t completion_tail;
+
+    // request currently being serviced
+    bool busy;
+    uint8_t command;
+    uint8_t id;
+    uint16_t count;
+    uint16_t progress;
+    uint32_t sector;
+    uint32_t buffer;
+    uint32_t tag;
+} disk_queue_t;
+
 typedef struct {
     disk_t disks[4];
     uint32_t buffer_pointer;
+    disk_queue_t queue;
 } disk_controller_t;
 
+// returns the physical page holding this page, or 0xFF if it isn't in memory
+static inline uint8_t find_physical_page(fox32_vm_t *vm, uint16_t page) {
+    uint8_t leaf = vm->physical_page_directory[page / FOX32_PAGE_LEAF_ENTRIES];
+    if (leaf == 0xFF) return 0xFF;
+    return vm->physical_page_leaves[leaf][page % FOX32_PAGE_LEAF_ENTRIES];
+}
+
 void flush_physical_page_out(fox32_vm_t *vm, uint8_t physical_page);
-void load_page_in(fox32_vm_t *vm, uint8_t page);
+void load_page_in(fox32_vm_t *vm, uint16_t page);
+void clean_dirty_pages(fox32_vm_t *vm, uint8_t sector_budget);
+void flush_dirty_pages(fox32_vm_t *vm);
+void disk_reset(void);
+uint32_t find_file(const char *filename);
 void new_disk(const char *filename, size_t id);
 void remove_disk(size_t id);
 uint64_t get_disk_size(size_t id);
 void set_disk_sector(size_t id, uint64_t sector);
 size_t read_disk_into_memory(size_t id);
 size_t write_disk_from_memory(size_t id);
+size_t read_disk_into_address(size_t id, uint32_t address);
+size_t write_disk_from_address(size_t id, uint32_t address);
+void disk_queue_service(fox32_vm_t *vm, uint8_t sector_budget);
+bool disk_queue_busy(void);
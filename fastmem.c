@@ -0,0 +1,29 @@
+#include <stdint.h>
+#include <spiram.h>
+
+#include "fastmem.h"
+
+// the default path goes through the SPI RAM library a byte at a time.
+// -DFASTMEM_ASM uses fastmem.s instead
+#ifndef FASTMEM_ASM
+
+uint32_t spi_fast_read_next(uint8_t length) {
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < length; i++)
+        value |= (uint32_t) SpiRamSeqReadU8() << (8 * i);
+    return value;
+}
+
+uint32_t spi_fast_read_start(uint32_t address, uint8_t length) {
+    SpiRamSeqReadStart(address > 0xFFFF ? 1 : 0, (uint16_t) address);
+    return spi_fast_read_next(length);
+}
+
+void spi_fast_write(uint32_t address, uint32_t value, uint8_t length) {
+    SpiRamSeqWriteStart(address > 0xFFFF ? 1 : 0, (uint16_t) address);
+    for (uint8_t i = 0; i < length; i++)
+        SpiRamSeqWriteU8(value >> (8 * i));
+    SpiRamSeqWriteEnd();
+}
+
+#endif
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+
+// guest RAM accesses of 1, 2 or 4 bytes at a physical SPI RAM address,
+// through the SPI RAM library in fastmem.c, or with -DFASTMEM_ASM in
+// assembly in fastmem.s. reads leave the RAM selected so the next one can
+// carry on where the last ended, just like SpiRamSeqReadStart, and
+// SpiRamSeqReadEnd finishes them. values are little endian
+//
+// -DFASTMEM_SELF_CHECK reads every access back through the SPI RAM
+// library, and stops the machine with FOX32_ERR_INTERNAL on a mismatch.
+// fastmem.s hasn't been run on hardware yet, so check it this way first
+uint32_t spi_fast_read_start(uint32_t address, uint8_t length);
+uint32_t spi_fast_read_next(uint8_t length);
+void spi_fast_write(uint32_t address, uint32_t value, uint8_t length);
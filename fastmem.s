@@ -0,0 +1,131 @@
+;
+; fast paths for guest RAM accesses, see fastmem.h
+;
+; these drive the SPI data register directly instead of going through the
+; kernel spiram.s for every byte, and do their bookkeeping while a byte
+; is in flight. the SPI bus is already set up by SpiRamInit
+;
+; only built with -DFASTMEM_ASM, otherwise fastmem.c provides these
+;
+
+#ifdef FASTMEM_ASM
+
+#include <avr/io.h>
+
+; the SPI RAM chip select, as in the kernel spiram.s
+#define SR_PORT _SFR_IO_ADDR(PORTA)
+#define SR_PIN  PA4
+
+#define SR_READ  0x03
+#define SR_WRITE 0x02
+
+; wait for the byte in flight. does not touch SREG
+.macro SPI_WAIT
+1:  in r0, _SFR_IO_ADDR(SPSR)
+    sbrs r0, SPIF
+    rjmp 1b
+.endm
+
+; clear a completion flag left behind by the timed transfers in spiram.s, so
+; SPI_WAIT does not see it
+.macro SPI_CLEAR
+    in r0, _SFR_IO_ADDR(SPSR)
+    in r0, _SFR_IO_ADDR(SPDR)
+.endm
+
+.section .text.fastmem
+
+;
+; uint32_t spi_fast_read_start(uint32_t address, uint8_t length)
+;
+; r25:r22 = address, bank in r24
+; r20     = length
+;
+.global spi_fast_read_start
+.type spi_fast_read_start, @function
+spi_fast_read_start:
+    SPI_CLEAR
+    cbi SR_PORT, SR_PIN
+    ldi r26, SR_READ
+    out _SFR_IO_ADDR(SPDR), r26
+    SPI_WAIT
+    out _SFR_IO_ADDR(SPDR), r24
+    SPI_WAIT
+    out _SFR_IO_ADDR(SPDR), r23
+    SPI_WAIT
+    out _SFR_IO_ADDR(SPDR), r22
+    SPI_WAIT
+    rjmp read_data
+
+;
+; uint32_t spi_fast_read_next(uint8_t length)
+;
+; r24 = length
+;
+.global spi_fast_read_next
+.type spi_fast_read_next, @function
+spi_fast_read_next:
+    mov r20, r24
+
+; clock in r20 bytes to r22 and up, and clear the rest of r25:r22
+read_data:
+    SPI_CLEAR
+    out _SFR_IO_ADDR(SPDR), r1
+    clr r23
+    clr r24
+    clr r25
+    dec r20
+    SPI_WAIT
+    in r22, _SFR_IO_ADDR(SPDR)
+    breq 9f
+    out _SFR_IO_ADDR(SPDR), r1
+    dec r20
+    SPI_WAIT
+    in r23, _SFR_IO_ADDR(SPDR)
+    breq 9f
+    out _SFR_IO_ADDR(SPDR), r1
+    SPI_WAIT
+    in r24, _SFR_IO_ADDR(SPDR)
+    out _SFR_IO_ADDR(SPDR), r1
+    SPI_WAIT
+    in r25, _SFR_IO_ADDR(SPDR)
+9:  ret
+
+;
+; void spi_fast_write(uint32_t address, uint32_t value, uint8_t length)
+;
+; r25:r22 = address, bank in r24
+; r21:r18 = value
+; r16     = length, call saved so only read
+;
+.global spi_fast_write
+.type spi_fast_write, @function
+spi_fast_write:
+    SPI_CLEAR
+    cbi SR_PORT, SR_PIN
+    ldi r26, SR_WRITE
+    out _SFR_IO_ADDR(SPDR), r26
+    mov r26, r16
+    SPI_WAIT
+    out _SFR_IO_ADDR(SPDR), r24
+    SPI_WAIT
+    out _SFR_IO_ADDR(SPDR), r23
+    SPI_WAIT
+    out _SFR_IO_ADDR(SPDR), r22
+    SPI_WAIT
+    out _SFR_IO_ADDR(SPDR), r18
+    dec r26
+    SPI_WAIT
+    breq 9f
+    out _SFR_IO_ADDR(SPDR), r19
+    dec r26
+    SPI_WAIT
+    breq 9f
+    out _SFR_IO_ADDR(SPDR), r20
+    SPI_WAIT
+    out _SFR_IO_ADDR(SPDR), r21
+    SPI_WAIT
+9:  sbi SR_PORT, SR_PIN
+    ret
+
+#endif
@@ -0,0 +1,3 @@
+#pragma once
+
+// nothing in the emulator touches registers directly
@@ -0,0 +1,8 @@
+#pragma once
+
+// sleep_mode waits for the next video interrupt, like SLEEP_MODE_IDLE
+
+#define SLEEP_MODE_IDLE 0
+#define set_sleep_mode(mode) ((void) (mode))
+
+void sleep_mode(void);
@@ -0,0 +1,22 @@
+#pragma once
+
+// host stand-in for bootlib's FAT access. a "cluster" is a file in the
+// directory named by UZEFOX_SD (default: the current directory), and a
+// position is the file in the top 8 bits and the sector in the rest
+
+#include <stdint.h>
+
+typedef struct {
+    uint8_t *bufp;
+} sdc_struct_t;
+
+uint8_t FS_Init(sdc_struct_t *sd);
+uint32_t FS_Find(sdc_struct_t *sd, uint16_t w1, uint16_t w2, uint16_t w3, uint16_t w4, uint16_t w5, uint16_t w6);
+void FS_Select_Cluster(sdc_struct_t *sd, uint32_t cluster);
+void FS_Reset_Sector(sdc_struct_t *sd);
+void FS_Next_Sector(sdc_struct_t *sd);
+uint32_t FS_Get_Sector(sdc_struct_t *sd);
+uint32_t FS_Get_Pos(sdc_struct_t *sd);
+void FS_Set_Pos(sdc_struct_t *sd, uint32_t pos);
+uint8_t FS_Read_Sector(sdc_struct_t *sd);
+uint8_t FS_Write_Sector(sdc_struct_t *sd);
@@ -0,0 +1,456 @@
+// host implementations of the Uzebox services the emulator uses, so the
+// same sources can be built and profiled on a PC with `make host`
+//
+// environment:
+//   UZEFOX_SD      directory holding the SD card's files (default: .)
+//   UZEFOX_FRAMES  stop after this many video frames (default: never)
+//
+// on exit the screen is printed to stdout, and the frame count and any
+// performance counters to stderr as "name value" lines. with
+// OPCODE_PROFILE, each opcode that ran is printed as
+// "opcode_XX count nanoseconds" and each operand type pair as
+// "operands_T_S count". with PC_SAMPLING, the sample histogram is dumped
+// to the SD card, and with INSTRUCTION_TRACE a running trace is ended
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <avr/sleep.h>
+#include <bootlib.h>
+#include <keyboard.h>
+#include <spiram.h>
+#include <util/atomic.h>
+#include <uzebox.h>
+
+#include "../bus.h"
+#include "../fastmem.h"
+#include "../perf.h"
+#include "../profile.h"
+#include "../sample.h"
+#include "../trace.h"
+
+// one NTSC frame, in microseconds
+#define FRAME_US 16683
+
+// frames to wait for the main loop to notice a stop before giving up on it
+#define STOP_GRACE_FRAMES 60
+
+#define MAX_FILES 8
+
+u8 vram[VRAM_SIZE];
+u8 aram[VRAM_SIZE];
+
+extern fox32_vm_t vm;
+
+static VsyncCallBackFunc vsync_callback = NULL;
+static volatile uint32_t frames = 0;
+static uint32_t frame_limit = 0;
+static volatile bool stop_requested = false;
+static uint32_t stop_frame = 0;
+
+static bool is_terminal = false;
+static struct termios old_termios;
+static u8 shown_vram[VRAM_SIZE];
+static uint8_t pending_key = 0;
+
+static uint8_t spi_ram[0x20000];
+static uint32_t spi_address;
+
+static const char *sd_directory = ".";
+static FILE *files[MAX_FILES];
+static char *file_paths[MAX_FILES];
+static uint8_t file_count = 0;
+static uint8_t current_file = 0;
+static uint32_t current_sector = 0;
+
+#ifdef PERF_COUNTERS
+static const char *perf_names[PERF_COUNTER_COUNT] = {
+    [PERF_INSTRUCTIONS] = "instructions",
+    [PERF_PAGE_FAULTS] = "page_faults",
+    [PERF_EVICTIONS] = "evictions",
+    [PERF_WRITEBACKS] = "writebacks",
+    [PERF_SD_SECTORS_READ] = "sd_sectors_read",
+    [PERF_SD_SECTORS_WRITTEN] = "sd_sectors_written",
+    [PERF_SPI_BYTES] = "spi_bytes",
+    [PERF_DISK_COMMANDS] = "disk_commands",
+    [PERF_INTERRUPTS] = "interrupts",
+    [PERF_IDLE_FRAMES] = "idle_frames",
+    [PERF_FRAMES] = "frames_counted",
+    [PERF_SCROLLS] = "scrolls",
+    [PERF_BATCHES] = "batches",
+    [PERF_LONG_BATCHES] = "long_batches",
+};
+#endif
+
+static char tile_to_char(u8 tile) {
+    if (tile >= 0x20 && tile < 0x7F) return tile;
+    if (tile == 0xB1) return '#';
+    return ' ';
+}
+
+static void print_screen(FILE *stream) {
+    for (uint8_t y = 0; y < SCREEN_TILES_V; y++) {
+        char line[SCREEN_TILES_H + 1];
+        uint8_t length = 0;
+        for (uint8_t x = 0; x < SCREEN_TILES_H; x++) {
+            line[x] = tile_to_char(vram[y * VRAM_TILES_H + x]);
+            if (line[x] != ' ') length = x + 1;
+        }
+        line[length] = 0;
+        fprintf(stream, "%s\n", line);
+    }
+}
+
+static void draw_screen(void) {
+    if (memcmp(shown_vram, vram, VRAM_SIZE) == 0) return;
+    memcpy(shown_vram, vram, VRAM_SIZE);
+    printf("\033[H\033[2J");
+    for (uint8_t y = 0; y < SCREEN_TILES_V; y++) {
+        for (uint8_t x = 0; x < SCREEN_TILES_H; x++)
+            putchar(tile_to_char(vram[y * VRAM_TILES_H + x]));
+        printf("\r\n");
+    }
+    fflush(stdout);
+}
+
+static void restore_terminal(void) {
+    if (is_terminal) tcsetattr(STDIN_FILENO, TCSANOW, &old_termios);
+}
+
+static void host_exit(int status) {
+    struct itimerval off = { 0 };
+    setitimer(ITIMER_REAL, &off, NULL);
+    restore_terminal();
+
+    if (is_terminal) printf("\033[H\033[2J");
+    print_screen(stdout);
+    fflush(stdout);
+
+#ifdef PC_SAMPLING
+    sample_dump(&vm);
+#endif
+#ifdef INSTRUCTION_TRACE
+    if (trace_enabled) {
+        trace_command(TRACE_COMMAND_STOP);
+        trace_flush(&vm);
+    }
+#endif
+
+    fprintf(stderr, "frames %u\n", (unsigned) frames);
+#ifdef PERF_COUNTERS
+    for (uint8_t i = 0; i < PERF_COUNTER_COUNT; i++)
+        fprintf(stderr, "%s %u\n", perf_names[i], (unsigned) perf_counters[i]);
+#endif
+#ifdef OPCODE_PROFILE
+    for (uint16_t i = 0; i < 256; i++) {
+        if (opcode_counts[i] == 0) continue;
+        fprintf(stderr, "opcode_%02X %u %u\n", i, (unsigned) opcode_counts[i], (unsigned) opcode_ticks[i]);
+    }
+    for (uint8_t i = 0; i < PROFILE_OPERAND_PAIRS; i++)
+        fprintf(stderr, "operands_%u_%u %u\n", i >> 2, i & 3, (unsigned) operand_counts[i]);
+#endif
+
+    for (uint8_t i = 0; i < file_count; i++) fclose(files[i]);
+    exit(status);
+}
+
+static void check_stop(void) {
+    if (stop_requested || power_request == POWER_OFF) host_exit(0);
+}
+
+// the video interrupt
+static void on_frame(int signal) {
+    (void) signal;
+    frames++;
+    if (vsync_callback) vsync_callback();
+
+    if (frame_limit != 0 && frames >= frame_limit && !stop_requested) {
+        stop_requested = true;
+        stop_frame = frames;
+    }
+
+    // the main loop is stuck, e.g. on a fatal error
+    if (stop_requested && frames - stop_frame > STOP_GRACE_FRAMES) {
+        static const char message[] = "main loop stopped responding\n";
+        write(STDERR_FILENO, message, sizeof(message) - 1);
+        _exit(2);
+    }
+}
+
+static void on_interrupt(int signal) {
+    (void) signal;
+    stop_requested = true;
+    stop_frame = frames;
+}
+
+__attribute__((constructor))
+static void host_init(void) {
+    const char *directory = getenv("UZEFOX_SD");
+    if (directory) sd_directory = directory;
+    const char *limit = getenv("UZEFOX_FRAMES");
+    if (limit) frame_limit = strtoul(limit, NULL, 0);
+
+    is_terminal = isatty(STDIN_FILENO) && isatty(STDOUT_FILENO);
+    if (is_terminal) {
+        tcgetattr(STDIN_FILENO, &old_termios);
+        struct termios raw = old_termios;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+    }
+    fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+
+    signal(SIGINT, on_interrupt);
+    struct sigaction action = { 0 };
+    action.sa_handler = on_frame;
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGALRM, &action, NULL);
+    struct itimerval interval = {
+        .it_interval = { 0, FRAME_US },
+        .it_value = { 0, FRAME_US }
+    };
+    setitimer(ITIMER_REAL, &interval, NULL);
+}
+
+// the opcode profile's clock, in nanoseconds
+uint32_t host_clock(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t) now.tv_sec * 1000000000u + (uint32_t) now.tv_nsec;
+}
+
+sigset_t host_interrupts_save(void) {
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGALRM);
+    sigprocmask(SIG_BLOCK, &block, &old);
+    return old;
+}
+
+void host_interrupts_restore(sigset_t *mask) {
+    sigprocmask(SIG_SETMASK, mask, NULL);
+}
+
+void sleep_mode(void) {
+    check_stop();
+    pause();
+}
+
+// video
+
+void SetBorderColor(u8 color) {
+    (void) color;
+}
+
+void ClearVram(void) {
+    memset(vram, 0, VRAM_SIZE);
+}
+
+void SetFont(char x, char y, unsigned char tile) {
+    vram[y * VRAM_TILES_H + x] = tile;
+}
+
+void PrintChar(int x, int y, char c) {
+    if (x < 0 || x >= VRAM_TILES_H || y < 0 || y >= VRAM_TILES_V) return;
+    vram[y * VRAM_TILES_H + x] = c;
+}
+
+void Print(int x, int y, const char *string) {
+    while (*string) PrintChar(x++, y, *string++);
+}
+
+void PrintHexByte(char x, char y, unsigned char byte) {
+    static const char digits[] = "0123456789ABCDEF";
+    PrintChar(x, y, digits[byte >> 4]);
+    PrintChar(x + 1, y, digits[byte & 0x0F]);
+}
+
+void PrintHexLong(char x, char y, u32 value) {
+    for (uint8_t i = 0; i < 4; i++)
+        PrintHexByte(x + i * 2, y, value >> (24 - i * 8));
+}
+
+void FontFill(u8 x, u8 y, u8 width, u8 height, u8 tile) {
+    for (uint8_t row = y; row < y + height && row < VRAM_TILES_V; row++) {
+        for (uint8_t column = x; column < x + width && column < VRAM_TILES_H; column++)
+            vram[row * VRAM_TILES_H + column] = tile;
+    }
+}
+
+void SetUserPostVsyncCallback(VsyncCallBackFunc callback) {
+    vsync_callback = callback;
+}
+
+// keyboard. the main loop polls once per frame, so the screen is drawn here
+
+void KeyboardPoll(void) {
+    check_stop();
+    if (is_terminal) draw_screen();
+    if (pending_key != 0) return;
+
+    uint8_t key;
+    if (read(STDIN_FILENO, &key, 1) == 1) {
+        if (key == '\n') key = 0x0D;
+        if (key == 0x7F) key = 0x08;
+        pending_key = key;
+    }
+}
+
+uint8_t KeyboardGetKey(bool release) {
+    uint8_t key = pending_key;
+    if (release) pending_key = 0;
+    return key;
+}
+
+// SPI RAM
+
+uint8_t SpiRamInit(void) {
+    return 1;
+}
+
+uint8_t SpiRamReadU8(uint8_t bank, uint16_t address) {
+    return spi_ram[((uint32_t) (bank & 1) << 16) | address];
+}
+
+void SpiRamWriteU8(uint8_t bank, uint16_t address, uint8_t value) {
+    spi_ram[((uint32_t) (bank & 1) << 16) | address] = value;
+}
+
+void SpiRamSeqReadStart(uint8_t bank, uint16_t address) {
+    spi_address = ((uint32_t) (bank & 1) << 16) | address;
+}
+
+uint8_t SpiRamSeqReadU8(void) {
+    uint8_t value = spi_ram[spi_address];
+    spi_address = (spi_address + 1) & (sizeof(spi_ram) - 1);
+    return value;
+}
+
+void SpiRamSeqReadInto(void *buffer, uint16_t length) {
+    uint8_t *bytes = buffer;
+    while (length--) *bytes++ = SpiRamSeqReadU8();
+}
+
+void SpiRamSeqReadEnd(void) {
+}
+
+void SpiRamSeqWriteStart(uint8_t bank, uint16_t address) {
+    spi_address = ((uint32_t) (bank & 1) << 16) | address;
+}
+
+void SpiRamSeqWriteU8(uint8_t value) {
+    spi_ram[spi_address] = value;
+    spi_address = (spi_address + 1) & (sizeof(spi_ram) - 1);
+}
+
+void SpiRamSeqWriteFrom(void *buffer, uint16_t length) {
+    uint8_t *bytes = buffer;
+    while (length--) SpiRamSeqWriteU8(*bytes++);
+}
+
+void SpiRamSeqWriteEnd(void) {
+}
+
+void SpiRamReadInto(uint8_t bank, uint16_t address, void *buffer, uint16_t length) {
+    SpiRamSeqReadStart(bank, address);
+    SpiRamSeqReadInto(buffer, length);
+}
+
+void SpiRamWriteFrom(uint8_t bank, uint16_t address, void *buffer, uint16_t length) {
+    SpiRamSeqWriteStart(bank, address);
+    SpiRamSeqWriteFrom(buffer, length);
+}
+
+// SD card
+
+uint8_t FS_Init(sdc_struct_t *sd) {
+    (void) sd;
+    return 0;
+}
+
+// the name is 8.3 with space padding, two characters to a word
+uint32_t FS_Find(sdc_struct_t *sd, uint16_t w1, uint16_t w2, uint16_t w3, uint16_t w4, uint16_t w5, uint16_t w6) {
+    (void) sd;
+    uint16_t words[6] = { w1, w2, w3, w4, w5, w6 };
+    char name[12];
+    for (uint8_t i = 0; i < 6; i++) {
+        name[i * 2] = words[i] >> 8;
+        name[i * 2 + 1] = words[i] & 0xFF;
+    }
+
+    char path[4096];
+    int length = snprintf(path, sizeof(path), "%s/", sd_directory);
+    for (uint8_t i = 0; i < 8 && name[i] != ' '; i++) path[length++] = name[i];
+    path[length++] = '.';
+    for (uint8_t i = 8; i < 11 && name[i] != ' '; i++) path[length++] = name[i];
+    path[length] = 0;
+
+    // the same file always has the same cluster
+    for (uint8_t i = 0; i < file_count; i++) {
+        if (strcmp(file_paths[i], path) == 0) return i + 1;
+    }
+
+    if (file_count == MAX_FILES) return 0;
+    FILE *file = fopen(path, "r+b");
+    if (!file) return 0;
+    files[file_count] = file;
+    file_paths[file_count] = strdup(path);
+    return ++file_count;
+}
+
+void FS_Select_Cluster(sdc_struct_t *sd, uint32_t cluster) {
+    (void) sd;
+    current_file = cluster;
+    current_sector = 0;
+}
+
+void FS_Reset_Sector(sdc_struct_t *sd) {
+    (void) sd;
+    current_sector = 0;
+}
+
+void FS_Next_Sector(sdc_struct_t *sd) {
+    (void) sd;
+    current_sector++;
+}
+
+uint32_t FS_Get_Sector(sdc_struct_t *sd) {
+    (void) sd;
+    return current_sector;
+}
+
+uint32_t FS_Get_Pos(sdc_struct_t *sd) {
+    (void) sd;
+    return ((uint32_t) current_file << 24) | current_sector;
+}
+
+void FS_Set_Pos(sdc_struct_t *sd, uint32_t pos) {
+    (void) sd;
+    current_file = pos >> 24;
+    current_sector = pos & 0x00FFFFFF;
+}
+
+uint8_t FS_Read_Sector(sdc_struct_t *sd) {
+    memset(sd->bufp, 0, 512);
+    if (current_file == 0 || current_file > file_count) return 1;
+    FILE *file = files[current_file - 1];
+    if (fseek(file, (long) current_sector * 512, SEEK_SET) != 0) return 1;
+    fread(sd->bufp, 1, 512, file);
+    return 0;
+}
+
+uint8_t FS_Write_Sector(sdc_struct_t *sd) {
+    if (current_file == 0 || current_file > file_count) return 1;
+    FILE *file = files[current_file - 1];
+    if (fseek(file, (long) current_sector * 512, SEEK_SET) != 0) return 1;
+    return fwrite(sd->bufp, 1, 512, file) == 512 ? 0 : 1;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+// host stand-in for the PS/2 keyboard driver, reading stdin
+
+#include <stdbool.h>
+#include <stdint.h>
+
+void KeyboardPoll(void);
+uint8_t KeyboardGetKey(bool release);
@@ -0,0 +1,21 @@
+#pragma once
+
+// host stand-in for the SPI RAM driver, two 64 KiB banks in an array
+
+#include <stdint.h>
+
+#include "defines.h"
+
+uint8_t SpiRamInit(void);
+uint8_t SpiRamReadU8(uint8_t bank, uint16_t address);
+void SpiRamWriteU8(uint8_t bank, uint16_t address, uint8_t value);
+void SpiRamReadInto(uint8_t bank, uint16_t address, void *buffer, uint16_t length);
+void SpiRamWriteFrom(uint8_t bank, uint16_t address, void *buffer, uint16_t length);
+void SpiRamSeqReadStart(uint8_t bank, uint16_t address);
+uint8_t SpiRamSeqReadU8(void);
+void SpiRamSeqReadInto(void *buffer, uint16_t length);
+void SpiRamSeqReadEnd(void);
+void SpiRamSeqWriteStart(uint8_t bank, uint16_t address);
+void SpiRamSeqWriteU8(uint8_t value);
+void SpiRamSeqWriteFrom(void *buffer, uint16_t length);
+void SpiRamSeqWriteEnd(void);
@@ -0,0 +1,15 @@
+#pragma once
+
+// the video interrupt is a signal on the host, so an atomic block holds it
+// off and then puts the signal mask back as it was
+
+#include <signal.h>
+
+#define ATOMIC_RESTORESTATE
+
+sigset_t host_interrupts_save(void);
+void host_interrupts_restore(sigset_t *mask);
+
+#define ATOMIC_BLOCK(type) \
+    for (sigset_t _host_mask = host_interrupts_save(), *_host_once = &_host_mask; \
+         _host_once; host_interrupts_restore(_host_once), _host_once = NULL)
@@ -0,0 +1,34 @@
+#pragma once
+
+// host stand-in for the Uzebox kernel's video and core services
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "defines.h"
+
+// the layout of video mode 41
+#ifndef SCREEN_TILES_H
+#define SCREEN_TILES_H 40
+#endif
+#ifndef SCREEN_TILES_V
+#define SCREEN_TILES_V 25
+#endif
+#define VRAM_TILES_H SCREEN_TILES_H
+#define VRAM_TILES_V SCREEN_TILES_V
+#define VRAM_SIZE (VRAM_TILES_H * VRAM_TILES_V)
+
+typedef void (*VsyncCallBackFunc)(void);
+
+extern u8 vram[VRAM_SIZE];
+extern u8 aram[VRAM_SIZE];
+
+void SetBorderColor(u8 color);
+void ClearVram(void);
+void SetFont(char x, char y, unsigned char tile);
+void PrintChar(int x, int y, char c);
+void Print(int x, int y, const char *string);
+void PrintHexByte(char x, char y, unsigned char byte);
+void PrintHexLong(char x, char y, u32 value);
+void FontFill(u8 x, u8 y, u8 width, u8 height, u8 tile);
+void SetUserPostVsyncCallback(VsyncCallBackFunc callback);
@@ -0,0 +1,65 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <util/atomic.h>
+
+#include "cpu.h"
+#include "irq.h"
+
+// nothing is delivered until the guest enables it, since smolrom and smolOS
+// don't install handlers for every vector
+static volatile uint8_t irq_enabled = 0;
+static volatile uint8_t irq_pending = 0;
+static uint8_t irq_vectors[IRQ_COUNT] = {
+    [IRQ_VSYNC] = IRQ_VSYNC_VECTOR
+};
+
+// safe to call from the video interrupt
+void irq_raise(uint8_t source) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (irq_enabled & (1 << source))
+            irq_pending |= (1 << source);
+    }
+}
+
+void irq_acknowledge(uint8_t mask) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        irq_pending &= ~mask;
+    }
+}
+
+void irq_set_vector(uint8_t source, uint8_t vector) {
+    irq_vectors[source] = vector;
+}
+
+void irq_set_enabled(uint8_t mask) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        irq_enabled = mask;
+        irq_pending &= mask;
+    }
+}
+
+uint8_t irq_get_vector(uint8_t source) {
+    return irq_vectors[source];
+}
+
+uint8_t irq_get_enabled(void) {
+    return irq_enabled;
+}
+
+uint8_t irq_get_pending(void) {
+    return irq_pending;
+}
+
+// deliver the highest priority pending interrupt, if the guest will take it
+bool irq_service(fox32_vm_t *vm) {
+    uint8_t pending = irq_pending;
+    if (!pending) return false;
+
+    for (uint8_t source = 0; source < IRQ_COUNT; source++) {
+        if (!(pending & (1 << source))) continue;
+        if (fox32_raise(vm, irq_vectors[source]) != FOX32_ERR_OK) return false;
+        irq_acknowledge(1 << source);
+        return true;
+    }
+    return false;
+}
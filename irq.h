@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cpu.h"
+
+// interrupt sources, in priority order
+enum {
+    IRQ_TIMER,
+    IRQ_DISK,
+    IRQ_KEYBOARD,
+    IRQ_VSYNC,
+    IRQ_COUNT
+};
+
+#define IRQ_VSYNC_VECTOR 0xFF
+
+void irq_raise(uint8_t source);
+void irq_acknowledge(uint8_t mask);
+void irq_set_vector(uint8_t source, uint8_t vector);
+void irq_set_enabled(uint8_t mask);
+uint8_t irq_get_vector(uint8_t source);
+uint8_t irq_get_enabled(void);
+uint8_t irq_get_pending(void);
+bool irq_service(fox32_vm_t *vm);
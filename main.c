@@ -1,7 +1,9 @@
 #include <stdbool.h>
+#include <stdnoreturn.h>
 #include <avr/io.h>
 #include <stdlib.h>
 #include <avr/pgmspace.h>
+#include <avr/sleep.h>
 #include <uzebox.h>
 #include <bootlib.h>
 #include <spiram.h>
@@ -9,19 +11,71 @@
 #include "bus.h"
 #include "cpu.h"
 #include "disk.h"
+#include "irq.h"
+#include "overlay.h"
+#include "perf.h"
+#include "sample.h"
+#include "serial.h"
+#include "snapshot.h"
+#include "timer.h"
+#include "trace.h"
+
+// the instruction budget of each batch adapts so that interrupts, input and
+// the disk queue are serviced about this many times per frame
+#ifndef BATCHES_PER_FRAME
+#define BATCHES_PER_FRAME 4
+#endif
+
+// the budget starts here and stays within these limits
+#ifndef INSTRUCTIONS_PER_BATCH
+#define INSTRUCTIONS_PER_BATCH 1024
+#endif
+#define MIN_INSTRUCTIONS_PER_BATCH 32
+#define MAX_INSTRUCTIONS_PER_BATCH 16384
 
 fox32_vm_t vm;
 
 extern sdc_struct_t sd_struct;
 extern uint8_t disk_buffer[512];
 
-int main() {
+// everything the guest can see, back to how it is at power on. SPI RAM
+// and the disk images are left alone, since all of RAM is paged in from
+// swap anyway
+static void reset(void) {
     fox32_init(&vm);
     vm.io_read = bus_io_read;
     vm.io_write = bus_io_write;
     vm.halted = false;
     vm.debug = false;
 
+    disk_reset();
+    irq_set_enabled(0);
+    timer_set_mode(TIMER_MODE_OFF);
+    overlay_init();
+    serial_init();
+    power_request = POWER_ON;
+}
+
+// write everything back to the SD card and stop
+static noreturn void power_off(void) {
+    flush_dirty_pages(&vm);
+#ifdef PC_SAMPLING
+    sample_dump(&vm);
+#endif
+#ifdef INSTRUCTION_TRACE
+    if (trace_enabled) {
+        trace_command(TRACE_COMMAND_STOP);
+        trace_flush(&vm);
+    }
+#endif
+    ClearVram();
+    Print(0, 0, PSTR("Powered off"));
+    while (true) sleep_mode();
+}
+
+int main() {
+    reset();
+
     sd_struct.bufp = &(disk_buffer[0]);
     FS_Init(&sd_struct);
     if (!SpiRamInit()) {
@@ -31,23 +85,104 @@ int main() {
         while (true);
     }
 
-    for (uint16_t i = 0; i < 0xFFFF; i++) {
-        SpiRamWriteU8(0, i, 0);
-        SpiRamWriteU8(1, i, 0);
-    }
+    // carry on from the last snapshot if there is a good one, otherwise boot
+    snapshot_init();
+    if (!snapshot_restore(&vm)) {
+        reset();
 
-    ClearVram();
+        for (uint16_t i = 0; i < 0xFFFF; i++) {
+            SpiRamWriteU8(0, i, 0);
+            SpiRamWriteU8(1, i, 0);
+        }
+
+        ClearVram();
 
-    new_disk("DISK0   IMG", 0);
+        new_disk(DISK_IMAGE_FILENAME, 0);
+    }
+
+    timer_init();
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    uint16_t last_idle_frame = frame_count;
+    uint16_t last_scan_frame = frame_count;
+    uint16_t budget = INSTRUCTIONS_PER_BATCH;
+    uint8_t full_batches = 0;
 
     while (true) {
         uint32_t executed = 0;
-        fox32_err_t error = fox32_resume(&vm, 65535, &executed);
+        uint16_t batch_frame = frame_count;
+        fox32_err_t error = fox32_resume(&vm, budget, &executed);
+        if (power_request == POWER_OFF) power_off();
+        if (power_request == POWER_RESET) {
+            reset();
+            continue;
+        }
+        if (power_request == POWER_SNAPSHOT) {
+            snapshot_save(&vm);
+            power_request = POWER_ON;
+        }
         if (error != FOX32_ERR_OK) {
             PrintHexByte(0, 22, error);
             PrintHexLong(0, 23, vm.pointer_instr);
             PrintHexLong(0, 24, vm.exception_operand);
             while (true);
         }
+
+        // a batch that used its whole budget measures what instructions
+        // cost right now. one that ran past a frame boundary is cut at once,
+        // since it held up everything else
+        PERF_COUNT(PERF_BATCHES, 1);
+        if (!vm.soft_halted) {
+            if (full_batches != 0xFF) full_batches++;
+            if ((uint16_t) (frame_count - batch_frame) > 1) {
+                PERF_COUNT(PERF_LONG_BATCHES, 1);
+                budget /= 4;
+                if (budget < MIN_INSTRUCTIONS_PER_BATCH) budget = MIN_INSTRUCTIONS_PER_BATCH;
+            }
+        }
+
+        if (last_scan_frame != frame_count) {
+            last_scan_frame = frame_count;
+
+            // then once per frame, aim for BATCHES_PER_FRAME full batches.
+            // frames the guest spent halted say nothing about the cost
+            if (full_batches != 0) {
+                if (full_batches < BATCHES_PER_FRAME) {
+                    budget /= 2;
+                    if (budget < MIN_INSTRUCTIONS_PER_BATCH) budget = MIN_INSTRUCTIONS_PER_BATCH;
+                } else if (full_batches > BATCHES_PER_FRAME * 2) {
+                    budget += budget / 4;
+                    if (budget > MAX_INSTRUCTIONS_PER_BATCH) budget = MAX_INSTRUCTIONS_PER_BATCH;
+                }
+            }
+            full_batches = 0;
+
+            serial_scan();
+            serial_flush();
+            overlay_service(&vm, OVERLAY_ROWS_PER_FRAME);
+            TRACE_FRAME();
+        }
+
+        disk_queue_service(&vm, DISK_QUEUE_SECTORS_PER_BATCH);
+        irq_service(&vm);
+        TRACE_SERVICE(&vm);
+
+        // halted with nothing to wake it up yet
+        bool halted = vm.soft_halted && !irq_get_pending() && !disk_queue_busy();
+
+        // if the guest is waiting on something, spend a little of this frame
+        // writing dirty pages back to swap so eviction finds clean ones
+        bool idle = halted | serial_input_starved();
+        if (idle && last_idle_frame != frame_count) {
+            last_idle_frame = frame_count;
+            PERF_COUNT(PERF_IDLE_FRAMES, 1);
+            clean_dirty_pages(&vm, CLEAN_SECTORS_PER_FRAME);
+        }
+
+        // nothing can run until an interrupt arrives, so sleep through the
+        // video interrupts until the next frame instead of spinning
+        if (halted) {
+            while (last_idle_frame == frame_count && !irq_get_pending())
+                sleep_mode();
+        }
     }
 }
@@ -0,0 +1,170 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <uzebox.h>
+
+#include "cpu.h"
+#include "overlay.h"
+#include "serial.h"
+#include "snapshot.h"
+
+static overlay_t overlays[OVERLAY_COUNT];
+static uint8_t service_hand = 0;
+
+// where the sink is writing within the row being converted
+static uint8_t sink_overlay;
+static uint16_t sink_x;
+static uint16_t sink_y;
+static uint8_t sink_byte;
+
+// true if a higher, enabled overlay covers this tile
+static bool is_tile_covered(uint8_t overlay, uint16_t x, uint16_t y) {
+    for (uint8_t i = overlay + 1; i < OVERLAY_COUNT; i++) {
+        overlay_t *above = &overlays[i];
+        if (!above->enabled) continue;
+        if (x >= above->x && x - above->x < above->width &&
+            y >= above->y && y - above->y < above->height)
+            return true;
+    }
+    return false;
+}
+
+static void overlay_sink(uint8_t value) {
+    uint8_t byte = sink_byte++ & 3;
+    if (byte > 1) {
+        if (byte == 3) sink_x++;
+        return;
+    }
+    if (sink_x >= SCREEN_TILES_H || sink_y >= SCREEN_TILES_V) return;
+    if (is_tile_covered(sink_overlay, sink_x, sink_y)) return;
+    if (byte == 0)
+        PrintChar(sink_x, sink_y, value);
+    else
+        aram[sink_y * VRAM_TILES_H + sink_x] = value;
+}
+
+void overlay_init(void) {
+    memset(overlays, 0, sizeof(overlays));
+    service_hand = 0;
+}
+
+void overlay_save(void) {
+    snapshot_write(overlays, sizeof(overlays));
+}
+
+void overlay_restore(void) {
+    snapshot_read(overlays, sizeof(overlays));
+    service_hand = 0;
+}
+
+uint32_t overlay_get_position(uint8_t overlay) {
+    if (overlay >= OVERLAY_COUNT) return 0;
+    return ((uint32_t) overlays[overlay].y << 16) | overlays[overlay].x;
+}
+
+uint32_t overlay_get_size(uint8_t overlay) {
+    if (overlay >= OVERLAY_COUNT) return 0;
+    return ((uint32_t) overlays[overlay].height << 16) | overlays[overlay].width;
+}
+
+uint32_t overlay_get_pointer(uint8_t overlay) {
+    if (overlay >= OVERLAY_COUNT) return 0;
+    return overlays[overlay].pointer;
+}
+
+bool overlay_get_enabled(uint8_t overlay) {
+    if (overlay >= OVERLAY_COUNT) return false;
+    return overlays[overlay].enabled;
+}
+
+void overlay_set_position(uint8_t overlay, uint32_t position) {
+    if (overlay >= OVERLAY_COUNT) return;
+    overlay_mark_below_dirty(overlay);
+    overlays[overlay].x = position;
+    overlays[overlay].y = position >> 16;
+    overlays[overlay].dirty_rows = OVERLAY_ALL_ROWS;
+}
+
+// larger overlays are cut down to the screen, which also keeps the dirty
+// rows within 32 bits
+void overlay_set_size(uint8_t overlay, uint32_t size) {
+    if (overlay >= OVERLAY_COUNT) return;
+    uint16_t width = size;
+    uint16_t height = size >> 16;
+    if (width > SCREEN_TILES_H) width = SCREEN_TILES_H;
+    if (height > SCREEN_TILES_V) height = SCREEN_TILES_V;
+    overlay_mark_below_dirty(overlay);
+    overlays[overlay].width = width;
+    overlays[overlay].height = height;
+    overlays[overlay].dirty_rows = OVERLAY_ALL_ROWS;
+}
+
+void overlay_set_pointer(uint8_t overlay, uint32_t pointer) {
+    if (overlay >= OVERLAY_COUNT) return;
+    overlays[overlay].pointer = pointer;
+    overlays[overlay].dirty_rows = OVERLAY_ALL_ROWS;
+}
+
+// a disabled overlay leaves its tiles behind until the terminal or a lower
+// overlay draws over them, since nothing underneath it is kept
+void overlay_set_enabled(uint8_t overlay, bool enabled) {
+    if (overlay >= OVERLAY_COUNT) return;
+    if (!enabled) overlay_mark_below_dirty(overlay);
+    overlays[overlay].enabled = enabled;
+    overlays[overlay].dirty_rows = OVERLAY_ALL_ROWS;
+}
+
+// mark one row, or OVERLAY_ALL_ROWS, as changed by the guest
+void overlay_mark_dirty(uint8_t overlay, uint32_t row) {
+    if (overlay >= OVERLAY_COUNT) return;
+    if (row == OVERLAY_ALL_ROWS)
+        overlays[overlay].dirty_rows = OVERLAY_ALL_ROWS;
+    else if (row < 32)
+        overlays[overlay].dirty_rows |= (uint32_t) 1 << row;
+}
+
+// redraw every overlay that may have been hidden by this one
+void overlay_mark_below_dirty(uint8_t overlay) {
+    if (overlay > OVERLAY_COUNT) overlay = OVERLAY_COUNT;
+    for (uint8_t i = 0; i < overlay; i++) {
+        if (overlays[i].enabled) overlays[i].dirty_rows = OVERLAY_ALL_ROWS;
+    }
+}
+
+// convert up to budget dirty rows into tiles, carrying on from where the
+// last call stopped so every overlay gets its turn
+void overlay_service(fox32_vm_t *vm, uint8_t budget) {
+    // overlays are placed on screen lines
+    serial_flush();
+
+    for (uint8_t checked = 0; checked < OVERLAY_COUNT && budget; checked++) {
+        overlay_t *overlay = &overlays[service_hand];
+        if (!overlay->enabled || overlay->width == 0) {
+            overlay->dirty_rows = 0;
+        }
+
+        for (uint8_t row = 0; row < overlay->height && overlay->dirty_rows && budget; row++) {
+            uint32_t mask = (uint32_t) 1 << row;
+            if (!(overlay->dirty_rows & mask)) continue;
+            overlay->dirty_rows &= ~mask;
+            budget--;
+
+            sink_overlay = service_hand;
+            sink_x = overlay->x;
+            sink_y = overlay->y + row;
+            if (sink_y >= SCREEN_TILES_V) continue;
+            sink_byte = 0;
+            uint32_t row_bytes = (uint32_t) overlay->width * 4;
+            if (fox32_stream(vm, overlay->pointer + row * row_bytes, row_bytes, overlay_sink) != FOX32_ERR_OK) {
+                // a bad pointer, so give up on this overlay until it changes
+                overlay->dirty_rows = 0;
+            }
+        }
+
+        // rows beyond the height are never converted
+        if (overlay->height < 32)
+            overlay->dirty_rows &= ((uint32_t) 1 << overlay->height) - 1;
+
+        if (!overlay->dirty_rows) service_hand = (service_hand + 1) % OVERLAY_COUNT;
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cpu.h"
+
+// overlays are drawn as tiles. position and size are in tiles, and each tile
+// is four bytes in guest RAM so the stream size stays width * height * 4:
+// the character, the raw aram attribute and two unused bytes
+#ifndef OVERLAY_COUNT
+#define OVERLAY_COUNT 4
+#endif
+
+// overlay rows converted to tiles per frame
+#ifndef OVERLAY_ROWS_PER_FRAME
+#define OVERLAY_ROWS_PER_FRAME 4
+#endif
+
+#define OVERLAY_ALL_ROWS 0xFFFFFFFF
+
+typedef struct {
+    uint16_t x, y;
+    uint8_t width, height;
+    uint32_t pointer;
+    bool enabled;
+    uint32_t dirty_rows;
+} overlay_t;
+
+void overlay_init(void);
+void overlay_save(void);
+void overlay_restore(void);
+uint32_t overlay_get_position(uint8_t overlay);
+uint32_t overlay_get_size(uint8_t overlay);
+uint32_t overlay_get_pointer(uint8_t overlay);
+bool overlay_get_enabled(uint8_t overlay);
+void overlay_set_position(uint8_t overlay, uint32_t position);
+void overlay_set_size(uint8_t overlay, uint32_t size);
+void overlay_set_pointer(uint8_t overlay, uint32_t pointer);
+void overlay_set_enabled(uint8_t overlay, bool enabled);
+void overlay_mark_dirty(uint8_t overlay, uint32_t row);
+void overlay_mark_below_dirty(uint8_t overlay);
+void overlay_service(fox32_vm_t *vm, uint8_t budget);
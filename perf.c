@@ -0,0 +1,35 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "perf.h"
+
+#ifdef PERF_COUNTERS
+
+uint32_t perf_counters[PERF_COUNTER_COUNT];
+// the guest reads from a snapshot, so all counters it sees are consistent
+static uint32_t perf_snapshot[PERF_COUNTER_COUNT];
+
+void perf_command(uint32_t command) {
+    switch (command) {
+        case PERF_COMMAND_SNAPSHOT:
+            memcpy(perf_snapshot, perf_counters, sizeof(perf_snapshot));
+            break;
+        case PERF_COMMAND_RESET:
+            memset(perf_counters, 0, sizeof(perf_counters));
+            memset(perf_snapshot, 0, sizeof(perf_snapshot));
+            break;
+    }
+}
+
+uint32_t perf_read(uint8_t counter) {
+    if (counter == PERF_IDLE_PERCENT) {
+        uint32_t frames = perf_snapshot[PERF_FRAMES];
+        uint32_t idle_frames = perf_snapshot[PERF_IDLE_FRAMES];
+        if (frames == 0) return 0;
+        return (uint32_t) (((uint64_t) idle_frames * 100) / frames);
+    }
+    if (counter >= PERF_COUNTER_COUNT) return 0;
+    return perf_snapshot[counter];
+}
+
+#endif
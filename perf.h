@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+
+// performance counters, readable by the guest through ports 0x80007000 and up
+enum {
+    PERF_INSTRUCTIONS,
+    PERF_PAGE_FAULTS,
+    PERF_EVICTIONS,
+    PERF_WRITEBACKS,
+    PERF_SD_SECTORS_READ,
+    PERF_SD_SECTORS_WRITTEN,
+    PERF_SPI_BYTES,
+    PERF_DISK_COMMANDS,
+    PERF_INTERRUPTS,
+    PERF_IDLE_FRAMES,
+    PERF_FRAMES,
+    PERF_SCROLLS,
+    PERF_BATCHES,
+    PERF_LONG_BATCHES,
+    PERF_COUNTER_COUNT
+};
+
+// not a counter, reads as the percentage of idle frames in the snapshot.
+// kept apart from the counters so adding one doesn't move it
+#define PERF_IDLE_PERCENT 0x80
+
+enum {
+    PERF_COMMAND_SNAPSHOT = 1,
+    PERF_COMMAND_RESET = 2
+};
+
+#ifdef PERF_COUNTERS
+extern uint32_t perf_counters[PERF_COUNTER_COUNT];
+#define PERF_COUNT(_counter, _amount) (perf_counters[(_counter)] += (_amount))
+
+void perf_command(uint32_t command);
+uint32_t perf_read(uint8_t counter);
+#else
+#define PERF_COUNT(_counter, _amount) ((void) 0)
+#endif
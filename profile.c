@@ -0,0 +1,37 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "profile.h"
+
+#ifdef OPCODE_PROFILE
+
+uint32_t opcode_counts[256];
+uint32_t operand_counts[PROFILE_OPERAND_PAIRS];
+#ifdef PROFILE_CLOCK
+uint32_t opcode_ticks[256];
+#endif
+
+void profile_reset(void) {
+    memset(opcode_counts, 0, sizeof(opcode_counts));
+    memset(operand_counts, 0, sizeof(operand_counts));
+#ifdef PROFILE_CLOCK
+    memset(opcode_ticks, 0, sizeof(opcode_ticks));
+#endif
+}
+
+uint32_t profile_read(uint16_t index) {
+    switch (index >> 8) {
+        case 0:
+            return opcode_counts[index & 0xFF];
+        case 1:
+            if ((index & 0xFF) >= PROFILE_OPERAND_PAIRS) return 0;
+            return operand_counts[index & 0xFF];
+#ifdef PROFILE_CLOCK
+        case 2:
+            return opcode_ticks[index & 0xFF];
+#endif
+    }
+    return 0;
+}
+
+#endif
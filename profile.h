@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+
+// opcode profile: how often each opcode byte (size and operation) runs, and
+// each pair of operand types. readable by the guest through ports
+// 0x80008000 and up when built with -DOPCODE_PROFILE:
+//   0x800080nn: executions of opcode byte nn
+//   0x800081nn: executions with operand types nn = target << 2 | source
+//   0x800082nn: time spent in opcode byte nn, in PROFILE_CLOCK ticks
+// writing anything to 0x80008000 clears it all
+#define PROFILE_OPERAND_PAIRS 16
+
+#ifdef OPCODE_PROFILE
+extern uint32_t opcode_counts[256];
+extern uint32_t operand_counts[PROFILE_OPERAND_PAIRS];
+#define PROFILE_OPCODE(_opcode, _target, _source) \
+    (opcode_counts[(_opcode)]++, operand_counts[((_target) << 2) | (_source)]++)
+
+// a free-running clock, if the platform has one to spare. the Uzebox
+// doesn't, since the video engine owns timer 1
+#ifdef PROFILE_CLOCK
+extern uint32_t opcode_ticks[256];
+uint32_t PROFILE_CLOCK(void);
+#define PROFILE_START() uint32_t _profile_start = PROFILE_CLOCK()
+#define PROFILE_END(_opcode) (opcode_ticks[(_opcode)] += PROFILE_CLOCK() - _profile_start)
+#else
+#define PROFILE_START() ((void) 0)
+#define PROFILE_END(_opcode) ((void) 0)
+#endif
+
+void profile_reset(void);
+uint32_t profile_read(uint16_t index);
+#else
+#define PROFILE_OPCODE(_opcode, _target, _source) ((void) 0)
+#define PROFILE_START() ((void) 0)
+#define PROFILE_END(_opcode) ((void) 0)
+#endif
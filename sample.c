@@ -0,0 +1,173 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <util/atomic.h>
+#include <avr/pgmspace.h>
+
+#include <uzebox.h>
+#include <bootlib.h>
+#include <spiram.h>
+
+#include "cpu.h"
+#include "disk.h"
+#include "perf.h"
+#include "sample.h"
+
+#ifdef PC_SAMPLING
+
+#define SAMPLE_DUMP_VERSION 1
+
+static const char sample_magic[8] PROGMEM = "UZEFOXPC";
+
+extern sdc_struct_t sd_struct;
+extern disk_controller_t disk_controller;
+extern uint8_t disk_buffer[512];
+
+// open addressed by bucket, a count of 0 marks a free slot. counts stick at
+// 0xFFFF rather than wrap
+static uint32_t sample_buckets[PC_SAMPLE_BUCKETS];
+static uint16_t sample_counts[PC_SAMPLE_BUCKETS];
+
+static uint32_t sample_total = 0;
+static volatile uint32_t sample_missed = 0;
+static uint32_t sample_dropped = 0;
+
+static uint32_t sample_file = 0;
+static uint32_t sample_begin = 0;
+static uint16_t dump_offset;
+
+#ifdef PC_SAMPLE_INTERVAL
+uint16_t sample_countdown = PC_SAMPLE_INTERVAL;
+#else
+volatile bool sample_due = false;
+#endif
+
+void sample_record(uint32_t pointer) {
+    uint32_t bucket = pointer >> PC_SAMPLE_SHIFT;
+    uint8_t slot = (bucket ^ (bucket >> 8)) & (PC_SAMPLE_BUCKETS - 1);
+
+    sample_total++;
+    for (uint8_t probe = 0; probe < PC_SAMPLE_BUCKETS; probe++) {
+        if (sample_counts[slot] == 0) {
+            sample_buckets[slot] = bucket;
+            sample_counts[slot] = 1;
+            return;
+        }
+        if (sample_buckets[slot] == bucket) {
+            if (sample_counts[slot] != 0xFFFF) sample_counts[slot]++;
+            return;
+        }
+        slot = (slot + 1) & (PC_SAMPLE_BUCKETS - 1);
+    }
+    sample_dropped++;
+}
+
+// runs from the video interrupt. a sample still due from the last frame
+// means the guest didn't run an instruction in between
+void sample_frame(void) {
+#ifndef PC_SAMPLE_INTERVAL
+    if (sample_due) sample_missed++;
+    sample_due = true;
+#endif
+}
+
+static void dump_write(const void *data, uint16_t length) {
+    const uint8_t *bytes = data;
+    while (length--) {
+        disk_buffer[dump_offset++] = *bytes++;
+        if (dump_offset == 512) {
+            FS_Write_Sector(&sd_struct);
+            FS_Next_Sector(&sd_struct);
+            PERF_COUNT(PERF_SD_SECTORS_WRITTEN, 1);
+            dump_offset = 0;
+        }
+    }
+}
+
+// write the histogram to the dump file, if there is one. this uses
+// disk_buffer and leaves the guest's disk selected
+bool sample_dump(fox32_vm_t *vm) {
+    // the SD card shares the SPI bus with the RAM
+    if (vm->is_consecutive_read) {
+        vm->is_consecutive_read = false;
+        SpiRamSeqReadEnd();
+    }
+
+    uint32_t old_pos = FS_Get_Pos(&sd_struct);
+    if (sample_file == 0) {
+        sample_file = find_file(PC_SAMPLE_FILENAME);
+        if (sample_file == 0) {
+            FS_Select_Cluster(&sd_struct, disk_controller.disks[0].file);
+            FS_Set_Pos(&sd_struct, old_pos);
+            return false;
+        }
+        FS_Select_Cluster(&sd_struct, sample_file);
+        sample_begin = FS_Get_Pos(&sd_struct);
+    }
+    FS_Select_Cluster(&sd_struct, sample_file);
+    FS_Set_Pos(&sd_struct, sample_begin);
+
+    sample_dump_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy_P(header.magic, sample_magic, sizeof(header.magic));
+    header.version = SAMPLE_DUMP_VERSION;
+    header.shift = PC_SAMPLE_SHIFT;
+    header.buckets = PC_SAMPLE_BUCKETS;
+    header.samples = sample_total;
+    header.missed = sample_read(1);
+    header.dropped = sample_dropped;
+
+    dump_offset = 0;
+    dump_write(&header, sizeof(header));
+    for (uint8_t slot = 0; slot < PC_SAMPLE_BUCKETS; slot++) {
+        uint32_t address = sample_buckets[slot] << PC_SAMPLE_SHIFT;
+        uint32_t count = sample_counts[slot];
+        dump_write(&address, 4);
+        dump_write(&count, 4);
+    }
+    if (dump_offset != 0) {
+        memset(disk_buffer + dump_offset, 0, 512 - dump_offset);
+        FS_Write_Sector(&sd_struct);
+        PERF_COUNT(PERF_SD_SECTORS_WRITTEN, 1);
+    }
+
+    FS_Select_Cluster(&sd_struct, disk_controller.disks[0].file);
+    FS_Set_Pos(&sd_struct, old_pos);
+    return true;
+}
+
+void sample_command(fox32_vm_t *vm, uint32_t command) {
+    switch (command) {
+        case SAMPLE_COMMAND_DUMP:
+            sample_dump(vm);
+            break;
+        case SAMPLE_COMMAND_RESET:
+            memset(sample_counts, 0, sizeof(sample_counts));
+            sample_total = 0;
+            sample_dropped = 0;
+            ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+                sample_missed = 0;
+            }
+            break;
+    }
+}
+
+uint32_t sample_read(uint8_t index) {
+    uint32_t value = 0;
+    switch (index) {
+        case 0:
+            value = sample_total;
+            break;
+        case 1:
+            ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+                value = sample_missed;
+            }
+            break;
+        case 2:
+            value = sample_dropped;
+            break;
+    }
+    return value;
+}
+
+#endif
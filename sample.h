@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cpu.h"
+
+// guest pc sampling profiler, enabled with -DPC_SAMPLING. the address of the
+// next instruction is sampled once per video frame, or every
+// PC_SAMPLE_INTERVAL instructions if that is defined, into a histogram of
+// 1 << PC_SAMPLE_SHIFT byte buckets. readable by the guest through ports
+// 0x80009000 and up:
+//   0x80009000: samples taken
+//   0x80009001: frames that passed without the guest running, so no sample
+//   0x80009002: samples that found the histogram full
+// writing a command to 0x80009000 dumps the histogram to the SD card or
+// clears it. it is also dumped when the machine powers off
+//
+// the dump file has to exist already, and be large enough for what is
+// written to it: a sample_dump_header_t, then PC_SAMPLE_BUCKETS records of
+// a 32 bit bucket address and a 32 bit sample count, empty ones included,
+// all little endian. tools/flat_profile.py turns it into a flat profile
+#define PC_SAMPLE_FILENAME "PCSAMPLEBIN"
+
+enum {
+    SAMPLE_COMMAND_DUMP = 1,
+    SAMPLE_COMMAND_RESET = 2
+};
+
+typedef struct {
+    char magic[8];
+    uint16_t version;
+    uint8_t shift;
+    uint8_t reserved;
+    uint16_t buckets;
+    uint16_t reserved2;
+    uint32_t samples;
+    uint32_t missed;
+    uint32_t dropped;
+} sample_dump_header_t;
+
+#ifdef PC_SAMPLING
+#ifndef PC_SAMPLE_BUCKETS
+#define PC_SAMPLE_BUCKETS 64 // a power of two
+#endif
+#ifndef PC_SAMPLE_SHIFT
+#define PC_SAMPLE_SHIFT 4
+#endif
+
+void sample_record(uint32_t pointer);
+
+#ifdef PC_SAMPLE_INTERVAL
+extern uint16_t sample_countdown;
+#define PC_SAMPLE(_pointer) do { \
+    if (--sample_countdown == 0) { \
+        sample_countdown = PC_SAMPLE_INTERVAL; \
+        sample_record((_pointer)); \
+    } \
+} while (0)
+#else
+extern volatile bool sample_due;
+#define PC_SAMPLE(_pointer) do { \
+    if (sample_due) { \
+        sample_due = false; \
+        sample_record((_pointer)); \
+    } \
+} while (0)
+#endif
+
+void sample_frame(void);
+void sample_command(fox32_vm_t *vm, uint32_t command);
+uint32_t sample_read(uint8_t index);
+bool sample_dump(fox32_vm_t *vm);
+#define PC_SAMPLE_FRAME() sample_frame()
+#else
+#define PC_SAMPLE(_pointer) ((void) 0)
+#define PC_SAMPLE_FRAME() ((void) 0)
+#endif
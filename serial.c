@@ -1,36 +1,73 @@
+#include <string.h>
 #include <avr/pgmspace.h>
 #include <uzebox.h>
 #include <keyboard.h>
 
+#include "irq.h"
+#include "perf.h"
+#include "serial.h"
+#include "snapshot.h"
+
+// must be a power of two
+#define KEY_QUEUE_SIZE 16
+
 uint8_t x = 0;
 uint8_t y = 0;
 uint8_t color = 0xFF;
 uint8_t state = 0;
 uint8_t mode;
 uint8_t param_0;
+bool input_starved = false;
+uint8_t scroll_pending = 0;
 
-static void scroll() {
-    if (y > (SCREEN_TILES_V - 1)) {
-        // scroll all lines up
-        for (u16 i = 0; i < (VRAM_TILES_H * (SCREEN_TILES_V - 1)); i++) {
-            vram[i] = vram[(i + VRAM_TILES_H)];
-            aram[i] = aram[(i + VRAM_TILES_H)];
-        }
+uint32_t write_pointer = 0;
 
-        // clear last line
-        for (u8 i = 0; i < VRAM_TILES_H; i++){
-            SetFont(i, SCREEN_TILES_V - 1, 0);
-        }
+uint8_t key_queue[KEY_QUEUE_SIZE];
+uint8_t key_queue_head = 0;
+uint8_t key_queue_tail = 0;
 
-        y = SCREEN_TILES_V - 1;
-        x = 0;
-    }
+// new lines are printed into the spare vram lines below the visible screen,
+// and the screen is moved up once per frame instead of once per line
+
+static void clear_line(uint8_t line) {
+    // SetFont knows the font's tile offset, so let it clear the first tile
+    // and copy that across the rest of the line
+    u8 *tiles = vram + (VRAM_TILES_H * line);
+    SetFont(0, line, 0);
+    memset(tiles + 1, tiles[0], VRAM_TILES_H - 1);
+}
+
+// move the screen up by all of the lines scrolled since the last flush
+static void scroll_flush() {
+    if (!scroll_pending) return;
+
+    // when the spare lines have run out the newest line is not in vram yet,
+    // so one line fewer is kept
+    uint8_t lines = SCREEN_TILES_V;
+    if (lines > VRAM_TILES_V - scroll_pending) lines = VRAM_TILES_V - scroll_pending;
+    uint16_t offset = VRAM_TILES_H * scroll_pending;
+    memmove(vram, vram + offset, VRAM_TILES_H * lines);
+    memmove(aram, aram + offset, VRAM_TILES_H * lines);
+    PERF_COUNT(PERF_SCROLLS, 1);
+
+    y -= scroll_pending;
+    scroll_pending = 0;
+}
+
+static void scroll() {
+    if (y < SCREEN_TILES_V + scroll_pending) return;
+
+    scroll_pending++;
+    if (y >= VRAM_TILES_V) scroll_flush();
+    clear_line(y);
+    x = 0;
 }
 
-static void print_char(u8 c) {
+static void print_char(uint8_t c) {
     if (x > SCREEN_TILES_H) {
         x = 0;
         y++;
+        scroll();
     }
 
     if (state == 1) {
@@ -40,13 +77,16 @@ static void print_char(u8 c) {
         switch (mode) {
             case 0xF0:
                 // fill
-                for (int i = 0; i < VRAM_SIZE; i++) aram[i] = color;
+                scroll_flush();
+                memset(aram, color, VRAM_SIZE);
                 FontFill(0, 0, SCREEN_TILES_H - 1, SCREEN_TILES_V - 1, param_0);
                 break;
             case 0xF1:
                 // move cursor
+                scroll_flush();
                 x = param_0;
                 y = c;
+                if (y > SCREEN_TILES_V) y = SCREEN_TILES_V;
                 break;
             case 0xF2:
                 // set color
@@ -57,7 +97,8 @@ static void print_char(u8 c) {
                 break;
             case 0xF3:
                 // fill line
-                for (int i = y * SCREEN_TILES_H + x; i < SCREEN_TILES_H; i++) aram[i] = color;
+                scroll_flush();
+                memset(aram + y * VRAM_TILES_H, color, VRAM_TILES_H);
                 FontFill(0, y, SCREEN_TILES_H - 1, 1, param_0);
                 break;
         }
@@ -76,7 +117,7 @@ static void print_char(u8 c) {
                 break;
             case 0x8A:
                 // cursor
-                aram[y * SCREEN_TILES_H + x] = color;
+                aram[y * VRAM_TILES_H + x] = color;
                 PrintChar(x++, y, 0xB1);
                 break;
             case 0xF0:
@@ -92,7 +133,7 @@ static void print_char(u8 c) {
                 break;
 
             default:
-                aram[y * SCREEN_TILES_H + x] = color;
+                aram[y * VRAM_TILES_H + x] = color;
                 PrintChar(x++, y, c);
                 break;
         }
@@ -101,13 +142,113 @@ static void print_char(u8 c) {
     scroll();
 }
 
-int serial_get(void) {
+// put the terminal back to how it is at power on
+void serial_init(void) {
+    x = 0;
+    y = 0;
+    color = 0xFF;
+    state = 0;
+    scroll_pending = 0;
+    input_starved = false;
+    write_pointer = 0;
+    key_queue_head = key_queue_tail;
+    ClearVram();
+}
+
+// the terminal as seen on screen. keys still queued are not kept
+void serial_save(void) {
+    snapshot_write(&x, 1);
+    snapshot_write(&y, 1);
+    snapshot_write(&color, 1);
+    snapshot_write(&state, 1);
+    snapshot_write(&mode, 1);
+    snapshot_write(&param_0, 1);
+    snapshot_write(&scroll_pending, 1);
+    snapshot_write(vram, VRAM_SIZE);
+    snapshot_write(aram, VRAM_SIZE);
+}
+
+void serial_restore(void) {
+    snapshot_read(&x, 1);
+    snapshot_read(&y, 1);
+    snapshot_read(&color, 1);
+    snapshot_read(&state, 1);
+    snapshot_read(&mode, 1);
+    snapshot_read(&param_0, 1);
+    snapshot_read(&scroll_pending, 1);
+    snapshot_read(vram, VRAM_SIZE);
+    snapshot_read(aram, VRAM_SIZE);
+}
+
+// called once per frame to move keys from the keyboard into the queue
+void serial_scan(void) {
     KeyboardPoll();
     u8 key = KeyboardGetKey(true);
+    if (key == 0) return;
     if (key == 0x0D) key = 0x0A;
-    return key;
+
+    // drop the key if the guest isn't keeping up
+    if ((uint8_t) (key_queue_tail - key_queue_head) >= KEY_QUEUE_SIZE) return;
+    key_queue[key_queue_tail % KEY_QUEUE_SIZE] = key;
+    key_queue_tail++;
+    irq_raise(IRQ_KEYBOARD);
+}
+
+uint8_t serial_pending(void) {
+    return key_queue_tail - key_queue_head;
+}
+
+int serial_get(void) {
+    if (key_queue_head == key_queue_tail) {
+        input_starved = true;
+        return 0;
+    }
+    return key_queue[key_queue_head++ % KEY_QUEUE_SIZE];
+}
+
+// true if the guest polled for input and got nothing since the last call
+bool serial_input_starved(void) {
+    bool starved = input_starved;
+    input_starved = false;
+    return starved;
 }
 
 void serial_put(int value) {
     print_char(value);
 }
+
+// called once per frame to show the lines printed since the last frame
+void serial_flush(void) {
+    scroll_flush();
+}
+
+void serial_set_write_pointer(uint32_t pointer) {
+    write_pointer = pointer;
+}
+
+// print length bytes from the write pointer, exactly as if each had been
+// written to port 0. stops at the first byte that can't be read, and
+// returns why
+fox32_err_t serial_write(fox32_vm_t *vm, uint32_t length) {
+    return fox32_stream(vm, write_pointer, length, print_char);
+}
+
+void serial_framebuffer_write(uint32_t address, uint8_t value) {
+    bool attribute = address >= TEXT_FRAMEBUFFER_ATTRS;
+    uint16_t cell = address & 0x0FFF;
+    if (cell >= SCREEN_TILES_H * SCREEN_TILES_V) return;
+    scroll_flush();
+    uint8_t column = cell % SCREEN_TILES_H;
+    uint8_t row = cell / SCREEN_TILES_H;
+    if (attribute) {
+        aram[row * VRAM_TILES_H + column] = value;
+    } else {
+        PrintChar(column, row, value);
+    }
+}
+
+// the guest has finished drawing a frame. framebuffer writes already went
+// straight to vram and aram, but any printed lines are shown now
+void serial_framebuffer_commit(void) {
+    scroll_flush();
+}
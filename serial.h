@@ -1,5 +1,26 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cpu.h"
+
+// text framebuffer, outside of RAM. one byte per cell, row by row, in the
+// character plane and then the attribute plane. attributes are raw aram values
+#define TEXT_FRAMEBUFFER_CHARS 0x02000000
+#define TEXT_FRAMEBUFFER_ATTRS 0x02001000
+#define TEXT_FRAMEBUFFER_END 0x02002000
+
 void serial_init(void);
+void serial_save(void);
+void serial_restore(void);
+void serial_scan(void);
+uint8_t serial_pending(void);
 int serial_get(void);
+bool serial_input_starved(void);
 void serial_put(int value);
+void serial_flush(void);
+void serial_set_write_pointer(uint32_t pointer);
+fox32_err_t serial_write(fox32_vm_t *vm, uint32_t length);
+void serial_framebuffer_write(uint32_t address, uint8_t value);
+void serial_framebuffer_commit(void);
@@ -130,6 +130,17 @@ ofb_stream_write:
     add r2, r1
     mov.8 [r2], [r0]
 
+    ; tell the overlay device which row changed
+    in r4, r3
+    add r3, 0x300
+    and r4, 0x0000FFFF
+    mul r4, 4
+    cmp r4, 0
+    ifz jmp ofb_stream_write_end
+    div r1, r4
+    out r3, r1
+
+ofb_stream_write_end:
     pop r4
     pop r3
     pop r2
@@ -0,0 +1,281 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+
+#include <uzebox.h>
+#include <bootlib.h>
+#include <spiram.h>
+
+#include "cpu.h"
+#include "disk.h"
+#include "irq.h"
+#include "overlay.h"
+#include "perf.h"
+#include "serial.h"
+#include "snapshot.h"
+#include "timer.h"
+
+// snapshot layout, one sector after another:
+//   header, written last so a half written snapshot is never used
+//   machine state: vm, disk controller, interrupt controller, timer,
+//   overlays and terminal, packed as a byte stream
+//   every resident page frame in physical page order, starting on a sector
+#define SNAPSHOT_VERSION 2
+
+typedef struct {
+    char magic[8];
+    uint16_t version;
+    uint16_t vm_size;
+    uint32_t memory_ram;
+    uint16_t page_size;
+    uint16_t physical_pages;
+    uint32_t disk_file;
+    uint16_t checksum;
+} snapshot_header_t;
+
+static const char snapshot_magic[8] PROGMEM = "UZEFOXSS";
+
+extern sdc_struct_t sd_struct;
+extern disk_controller_t disk_controller;
+extern uint8_t disk_buffer[512];
+
+static uint32_t snapshot_file = 0;
+static uint32_t snapshot_begin = 0;
+static bool snapshot_valid = false;
+
+// where the stream is within disk_buffer, and a running checksum of it
+static uint16_t stream_offset;
+static uint16_t stream_checksum;
+
+static void checksum_byte(uint8_t byte) {
+    stream_checksum = ((stream_checksum << 1) | (stream_checksum >> 15)) + byte;
+}
+
+static void seek_snapshot(void) {
+    FS_Select_Cluster(&sd_struct, snapshot_file);
+    FS_Set_Pos(&sd_struct, snapshot_begin);
+}
+
+// the guest's disk is the selected file everywhere else
+static void seek_disk(uint32_t pos) {
+    FS_Select_Cluster(&sd_struct, disk_controller.disks[0].file);
+    FS_Set_Pos(&sd_struct, pos);
+}
+
+static void write_sector(void) {
+    FS_Write_Sector(&sd_struct);
+    FS_Next_Sector(&sd_struct);
+    PERF_COUNT(PERF_SD_SECTORS_WRITTEN, 1);
+}
+
+static void read_sector(void) {
+    FS_Read_Sector(&sd_struct);
+    FS_Next_Sector(&sd_struct);
+    PERF_COUNT(PERF_SD_SECTORS_READ, 1);
+}
+
+// find the snapshot file. without one, snapshots are not available
+void snapshot_init(void) {
+    snapshot_file = find_file(SNAPSHOT_FILENAME);
+    if (snapshot_file == 0) return;
+    FS_Select_Cluster(&sd_struct, snapshot_file);
+    snapshot_begin = FS_Get_Pos(&sd_struct);
+}
+
+// the snapshot refers to the swap area and disk image as they are now, so
+// it is thrown away before either is written. this uses disk_buffer
+void snapshot_invalidate(void) {
+    if (!snapshot_valid) return;
+    snapshot_valid = false;
+
+    uint32_t old_pos = FS_Get_Pos(&sd_struct);
+    seek_snapshot();
+    memset(disk_buffer, 0, 512);
+    write_sector();
+    seek_disk(old_pos);
+}
+
+void snapshot_write(const void *data, uint16_t length) {
+    const uint8_t *bytes = data;
+    while (length--) {
+        checksum_byte(*bytes);
+        disk_buffer[stream_offset++] = *bytes++;
+        if (stream_offset == 512) {
+            write_sector();
+            stream_offset = 0;
+        }
+    }
+}
+
+void snapshot_read(void *data, uint16_t length) {
+    uint8_t *bytes = data;
+    while (length--) {
+        if (stream_offset == 512) {
+            read_sector();
+            stream_offset = 0;
+        }
+        *bytes = disk_buffer[stream_offset++];
+        checksum_byte(*bytes++);
+    }
+}
+
+static void save_irq(void) {
+    uint8_t enabled = irq_get_enabled();
+    snapshot_write(&enabled, 1);
+    for (uint8_t source = 0; source < IRQ_COUNT; source++) {
+        uint8_t vector = irq_get_vector(source);
+        snapshot_write(&vector, 1);
+    }
+}
+
+static void restore_irq(void) {
+    uint8_t enabled;
+    snapshot_read(&enabled, 1);
+    for (uint8_t source = 0; source < IRQ_COUNT; source++) {
+        uint8_t vector;
+        snapshot_read(&vector, 1);
+        irq_set_vector(source, vector);
+    }
+    irq_set_enabled(enabled);
+}
+
+static void fill_header(fox32_vm_t *vm, snapshot_header_t *header) {
+    memset(header, 0, sizeof(snapshot_header_t));
+    memcpy_P(header->magic, snapshot_magic, sizeof(header->magic));
+    header->version = SNAPSHOT_VERSION;
+    header->vm_size = sizeof(fox32_vm_t);
+    header->memory_ram = FOX32_MEMORY_RAM;
+    header->page_size = FOX32_PAGE_SIZE;
+    header->physical_pages = FOX32_PHYSICAL_PAGES;
+    header->disk_file = disk_controller.disks[0].file;
+}
+
+// write the whole machine to the snapshot file. the guest carries on
+// running afterwards, and the snapshot stays usable until the next write to
+// swap or to the disk image
+bool snapshot_save(fox32_vm_t *vm) {
+    if (snapshot_file == 0) return false;
+
+    // clean every page first, since writing swap would throw the snapshot
+    // away again
+    flush_dirty_pages(vm);
+    if (vm->is_consecutive_read) {
+        vm->is_consecutive_read = false;
+        SpiRamSeqReadEnd();
+    }
+
+    SetBorderColor(0x3F);
+    uint32_t old_pos = FS_Get_Pos(&sd_struct);
+    snapshot_valid = false;
+
+    // throw away the old header, then skip it
+    seek_snapshot();
+    memset(disk_buffer, 0, 512);
+    write_sector();
+
+    stream_offset = 0;
+    stream_checksum = 0;
+    snapshot_write(vm, sizeof(fox32_vm_t));
+    snapshot_write(&disk_controller, sizeof(disk_controller_t));
+    save_irq();
+    timer_save();
+    overlay_save();
+    serial_save();
+    if (stream_offset != 0) {
+        memset(disk_buffer + stream_offset, 0, 512 - stream_offset);
+        write_sector();
+    }
+
+    // page frames, a sector at a time
+    for (uint8_t physical_page = 0; physical_page < FOX32_PHYSICAL_PAGES; physical_page++) {
+        if (!(vm->physical_memory_bitmap[physical_page / 8] & (1 << (physical_page % 8)))) continue;
+        uint32_t physical_address = (uint32_t) physical_page * (uint32_t) FOX32_PAGE_SIZE;
+        uint8_t physical_bank = physical_address > 0xFFFF ? 1 : 0;
+        physical_address &= 0xFFFF;
+        for (uint8_t sector = 0; sector < FOX32_SWAP_SECTORS_PER_PAGE; sector++) {
+            SpiRamReadInto(physical_bank, physical_address, disk_buffer, 512);
+            PERF_COUNT(PERF_SPI_BYTES, 512);
+            for (uint16_t i = 0; i < 512; i++) checksum_byte(disk_buffer[i]);
+            write_sector();
+            physical_address += 512;
+        }
+    }
+
+    // now the header, which makes it all valid
+    snapshot_header_t header;
+    fill_header(vm, &header);
+    header.checksum = stream_checksum;
+    seek_snapshot();
+    memset(disk_buffer, 0, 512);
+    memcpy(disk_buffer, &header, sizeof(header));
+    write_sector();
+    snapshot_valid = true;
+
+    seek_disk(old_pos);
+    SetBorderColor(0x00);
+    return true;
+}
+
+// load the machine from the snapshot file if there is a good one. on false
+// the machine state is undefined and has to be reset
+bool snapshot_restore(fox32_vm_t *vm) {
+    if (snapshot_file == 0) return false;
+
+    SetBorderColor(0x3F);
+    seek_snapshot();
+    read_sector();
+
+    // anything that changes the layout of the state makes the snapshot stale
+    snapshot_header_t header;
+    snapshot_header_t expected;
+    memcpy(&header, disk_buffer, sizeof(header));
+    fill_header(vm, &expected);
+    expected.disk_file = find_file(DISK_IMAGE_FILENAME);
+    expected.checksum = header.checksum;
+    if (memcmp(&header, &expected, sizeof(header)) != 0) {
+        SetBorderColor(0x00);
+        return false;
+    }
+
+    // io handlers are addresses in this build, so keep the current ones
+    fox32_io_read_t *io_read = vm->io_read;
+    fox32_io_write_t *io_write = vm->io_write;
+
+    stream_offset = 512;
+    stream_checksum = 0;
+    snapshot_read(vm, sizeof(fox32_vm_t));
+    snapshot_read(&disk_controller, sizeof(disk_controller_t));
+    restore_irq();
+    timer_restore();
+    overlay_restore();
+    serial_restore();
+    vm->io_read = io_read;
+    vm->io_write = io_write;
+    vm->is_consecutive_read = false;
+
+    for (uint8_t physical_page = 0; physical_page < FOX32_PHYSICAL_PAGES; physical_page++) {
+        if (!(vm->physical_memory_bitmap[physical_page / 8] & (1 << (physical_page % 8)))) continue;
+        uint32_t physical_address = (uint32_t) physical_page * (uint32_t) FOX32_PAGE_SIZE;
+        uint8_t physical_bank = physical_address > 0xFFFF ? 1 : 0;
+        physical_address &= 0xFFFF;
+        for (uint8_t sector = 0; sector < FOX32_SWAP_SECTORS_PER_PAGE; sector++) {
+            read_sector();
+            for (uint16_t i = 0; i < 512; i++) checksum_byte(disk_buffer[i]);
+            SpiRamWriteFrom(physical_bank, physical_address, disk_buffer, 512);
+            PERF_COUNT(PERF_SPI_BYTES, 512);
+            physical_address += 512;
+        }
+    }
+
+    SetBorderColor(0x00);
+    if (stream_checksum != header.checksum) {
+        // reset() leaves the disks alone, so don't keep the ones just read
+        memset(&disk_controller, 0, sizeof(disk_controller_t));
+        return false;
+    }
+
+    seek_disk(disk_controller.disks[0].swap_begin);
+    snapshot_valid = true;
+    return true;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cpu.h"
+
+// the snapshot is kept in this file on the SD card, which has to exist
+// already and be large enough for the state plus 128 KiB of page frames
+#define SNAPSHOT_FILENAME "SNAPSHOTBIN"
+
+void snapshot_init(void);
+void snapshot_invalidate(void);
+bool snapshot_save(fox32_vm_t *vm);
+bool snapshot_restore(fox32_vm_t *vm);
+void snapshot_write(const void *data, uint16_t length);
+void snapshot_read(void *data, uint16_t length);
@@ -0,0 +1,57 @@
+; a completion ring the guest can't write must turn the disk queue off
+; instead of posting a completion that was never written
+
+    org 0x00000800
+
+const QUEUE_PORT: 0x80006000
+const UPTIME_PORT: 0x80000706
+
+const SUBMISSION: 0x00001000
+const COMPLETION: 0xF0000000 ; rom
+
+    mov r0, QUEUE_PORT
+    out r0, SUBMISSION
+    inc r0
+    out r0, COMPLETION
+    inc r0
+    out r0, 1                ; one entry, which also resets the queue
+
+    ; the submission entry
+    mov [0x00001000], 0x00010001 ; read 1 sector from disk 0
+    mov [0x00001004], 0          ; sector 0
+    mov [0x00001008], 0x00002000
+    mov [0x0000100C], 0x1234     ; tag
+    mov r0, QUEUE_PORT
+    add r0, 3
+    out r0, 1                ; doorbell
+
+    ; give the queue plenty of time, then no completion may have been posted
+wait:
+    in r1, UPTIME_PORT
+    cmp r1, 500
+    iflt rjmp wait
+
+    add r0, 1
+    in r1, r0                ; completions posted
+    mov r2, fail
+    cmp r1, 0
+    ifz mov r2, pass
+
+    mov r0, 0
+report_loop:
+    movz.8 r1, [r2]
+    cmp r1, 0
+    ifz jmp done
+    out r0, r1               ; serial port
+    inc r2
+    rjmp report_loop
+
+    ; stay up so the result is still on the screen when the host exits
+done:
+    rjmp done
+
+pass: data.strz "PASS"
+fail: data.strz "FAIL"
+
+    org.pad 0x000009FC
+    data.32 0x523C334C
@@ -0,0 +1,46 @@
+#!/bin/sh
+# run the guest tests under the host build
+#
+# usage: tests/run.sh
+#
+# each test is a boot sector, assembled with $FOX32ASM and written to the
+# start of a blank disk image. it prints PASS or FAIL to the serial port
+# and then waits, and the screen is checked once the host build stops
+
+set -e
+
+cd "$(dirname "$0")/.."
+
+FOX32ASM=${FOX32ASM:-../fox32asm/target/release/fox32asm}
+# run each test for this many frames
+TEST_FRAMES=${TEST_FRAMES:-120}
+TESTS="disk_queue_wrap disk_queue_ring"
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+for test in $TESTS; do
+    (cd tests && "$FOX32ASM" $test.asm "$WORK/$test.bin")
+done
+
+make -s host -B
+
+failed=0
+for test in $TESTS; do
+    mkdir -p "$WORK/sd"
+    rm -f "$WORK/sd/DISK0.IMG"
+    truncate -s 16M "$WORK/sd/DISK0.IMG"
+    dd if="$WORK/$test.bin" of="$WORK/sd/DISK0.IMG" conv=notrunc 2>/dev/null
+
+    UZEFOX_SD="$WORK/sd" UZEFOX_FRAMES=$TEST_FRAMES \
+        ./bin/uzefox-host < /dev/null > "$WORK/screen" 2> /dev/null
+
+    if grep -q PASS "$WORK/screen"; then
+        echo "$test: pass"
+    else
+        echo "$test: FAIL"
+        failed=1
+    fi
+done
+
+exit $failed
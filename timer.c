@@ -0,0 +1,114 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <util/atomic.h>
+
+#include <uzebox.h>
+
+#include "irq.h"
+#include "perf.h"
+#include "sample.h"
+#include "snapshot.h"
+#include "timer.h"
+
+// one NTSC frame is 1001/60 ms, or 16 ms and 683 us
+#define FRAME_MS 16
+#define FRAME_US_REMAINDER 683
+
+volatile uint16_t frame_count = 0;
+
+static volatile uint32_t uptime_ms = 0;
+static volatile uint16_t uptime_us = 0;
+
+static volatile uint8_t timer_mode = TIMER_MODE_OFF;
+static volatile uint32_t timer_period = 0;
+static volatile uint32_t timer_deadline = 0;
+
+// runs from the video interrupt once per frame
+static void vsync_callback(void) {
+    frame_count++;
+    PERF_COUNT(PERF_FRAMES, 1);
+    PC_SAMPLE_FRAME();
+    irq_raise(IRQ_VSYNC);
+
+    uptime_ms += FRAME_MS;
+    uptime_us += FRAME_US_REMAINDER;
+    if (uptime_us >= 1000) {
+        uptime_us -= 1000;
+        uptime_ms++;
+    }
+
+    if (timer_mode != TIMER_MODE_OFF && (int32_t) (uptime_ms - timer_deadline) >= 0) {
+        irq_raise(IRQ_TIMER);
+        if (timer_mode == TIMER_MODE_PERIODIC && timer_period != 0)
+            timer_deadline += timer_period;
+        else
+            timer_mode = TIMER_MODE_OFF;
+    }
+}
+
+void timer_init(void) {
+    SetUserPostVsyncCallback(&vsync_callback);
+}
+
+// the uptime goes into the snapshot along with the timer, so the guest's
+// clock carries on from where it was and an armed timer still fires
+typedef struct {
+    uint32_t uptime_ms;
+    uint16_t uptime_us;
+    uint8_t mode;
+    uint32_t period;
+    uint32_t deadline;
+} timer_state_t;
+
+void timer_save(void) {
+    timer_state_t state;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        state.uptime_ms = uptime_ms;
+        state.uptime_us = uptime_us;
+        state.mode = timer_mode;
+        state.period = timer_period;
+        state.deadline = timer_deadline;
+    }
+    snapshot_write(&state, sizeof(state));
+}
+
+void timer_restore(void) {
+    timer_state_t state;
+    snapshot_read(&state, sizeof(state));
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        uptime_ms = state.uptime_ms;
+        uptime_us = state.uptime_us;
+        timer_mode = state.mode;
+        timer_period = state.period;
+        timer_deadline = state.deadline;
+    }
+}
+
+uint32_t timer_get_ms(void) {
+    uint32_t ms;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        ms = uptime_ms;
+    }
+    return ms;
+}
+
+void timer_set_period(uint32_t ms) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        timer_period = ms;
+    }
+}
+
+// arming the timer starts the period from now
+void timer_set_mode(uint8_t mode) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        timer_deadline = uptime_ms + timer_period;
+        timer_mode = mode <= TIMER_MODE_PERIODIC ? mode : TIMER_MODE_OFF;
+    }
+    irq_acknowledge(1 << IRQ_TIMER);
+}
+
+// setting the vector also enables the timer interrupt
+void timer_set_vector(uint8_t vector) {
+    irq_set_vector(IRQ_TIMER, vector);
+    irq_set_enabled(irq_get_enabled() | (1 << IRQ_TIMER));
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+enum {
+    TIMER_MODE_OFF,
+    TIMER_MODE_ONESHOT,
+    TIMER_MODE_PERIODIC
+};
+
+extern volatile uint16_t frame_count;
+
+void timer_init(void);
+void timer_save(void);
+void timer_restore(void);
+uint32_t timer_get_ms(void);
+void timer_set_period(uint32_t ms);
+void timer_set_mode(uint8_t mode);
+void timer_set_vector(uint8_t vector);
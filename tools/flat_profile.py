@@ -0,0 +1,55 @@
+#!/usr/bin/env python3
+# turn a pc sample dump (PCSAMPLE.BIN, see sample.h) into a flat profile
+
+import argparse
+import struct
+import sys
+from pathlib import Path
+
+from symbols import Symbols, add_arguments
+
+HEADER = "<8sHBBHHIII"
+
+
+def read_dump(path):
+    dump = Path(path).read_bytes()
+    magic, version, shift, _, buckets, _, samples, missed, dropped = \
+        struct.unpack_from(HEADER, dump, 0)
+    if magic != b"UZEFOXPC" or version != 1:
+        sys.exit(f"{path}: not a pc sample dump")
+    histogram = {}
+    offset = struct.calcsize(HEADER)
+    for _ in range(buckets):
+        address, count = struct.unpack_from("<II", dump, offset)
+        offset += 8
+        if count:
+            histogram[address] = count
+    return histogram, 1 << shift, samples, missed, dropped
+
+
+def main():
+    parser = argparse.ArgumentParser(description="print a flat profile from a pc sample dump")
+    parser.add_argument("dump", help="PCSAMPLE.BIN from the SD card")
+    add_arguments(parser)
+    args = parser.parse_args()
+
+    symbols = Symbols(args)
+    histogram, bucket_size, samples, missed, dropped = read_dump(args.dump)
+
+    routines = {}
+    for bucket, count in histogram.items():
+        name = symbols.lookup(bucket)
+        routines[name] = routines.get(name, 0) + count
+
+    print(f"{samples} samples in {bucket_size} byte buckets, "
+          f"{missed} frames not running, {dropped} dropped")
+    total = sum(routines.values())
+    if total == 0:
+        return
+    print(f"{'%':>6} {'samples':>8}  routine")
+    for name, count in sorted(routines.items(), key=lambda item: -item[1]):
+        print(f"{100 * count / total:6.2f} {count:8}  {name}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,120 @@
+# guest routine addresses for the profiling tools
+#
+# routine addresses come from the jump tables named in the .def files: the
+# ROM's tables are read out of smolrom.h, and fox32os's out of kernel.fxf if
+# it is given. an address between two known routines belongs to the one
+# before, so routines that aren't exported show up under their neighbour
+
+import bisect
+import re
+import struct
+import sys
+from pathlib import Path
+
+REPO = Path(__file__).resolve().parent.parent
+
+ROM_START = 0xF0000000
+
+# the emulator moves these ROM jump tables down to where smolrom keeps them
+ROM_TABLES = {
+    0xF0040000: 0xF0003000, # system
+    0xF0045000: 0xF0003100, # disk
+    0xF0046000: 0xF0003200, # memory
+    0xF0047000: 0xF0003300, # integer
+}
+
+# fox32os copies its jump table from the start of its code to here
+OS_TABLE = 0x00000800
+KERNEL_LOAD_ADDRESS = 0x00017000
+
+DEF_LINE = re.compile(r"^\s*(\w+):\s*jmp\s*\[\s*(0x[0-9A-Fa-f]+)\s*\]")
+
+
+def read_defs(path):
+    defs = []
+    for line in Path(path).read_text().splitlines():
+        match = DEF_LINE.match(line)
+        if match:
+            defs.append((match.group(1), int(match.group(2), 16)))
+    return defs
+
+
+def read_rom(path):
+    text = Path(path).read_text()
+    text = text[text.index("{") + 1:text.rindex("}")]
+    return bytes(int(byte, 16) for byte in re.findall(r"0x[0-9A-Fa-f]{2}", text))
+
+
+def rom_word(rom, address):
+    for table, moved in ROM_TABLES.items():
+        if table <= address < table + 0x1000:
+            address = address - table + moved
+            break
+    offset = address - ROM_START
+    if offset < 0 or offset + 4 > len(rom):
+        return None
+    return struct.unpack_from("<I", rom, offset)[0]
+
+
+def read_kernel(path, load_address):
+    fxf = Path(path).read_bytes()
+    if fxf[0:3] != b"FXF":
+        sys.exit(f"{path}: not an FXF binary")
+    code_size, code_pointer = struct.unpack_from("<II", fxf, 4)
+    return fxf[code_pointer:code_pointer + code_size], load_address + code_pointer
+
+
+def kernel_word(kernel, address):
+    code, base = kernel
+    offset = address - OS_TABLE
+    if offset < 0 or offset + 4 > len(code):
+        return None
+    # table entries are relocated by adding where the code was loaded
+    return struct.unpack_from("<I", code, offset)[0] + base
+
+
+def region(address):
+    if address >= ROM_START:
+        return "[smolrom]"
+    return "[ram]"
+
+
+def add_arguments(parser):
+    parser.add_argument("--rom", default=REPO / "smolrom.h", help="ROM the emulator was built with")
+    parser.add_argument("--rom-def", default=REPO / "smolrom" / "fox32rom.def")
+    parser.add_argument("--kernel", help="kernel.fxf the guest booted, for fox32os routines")
+    parser.add_argument("--kernel-def", default=REPO / "smolos" / "fox32os.def")
+    parser.add_argument("--kernel-load-address", type=lambda x: int(x, 0), default=KERNEL_LOAD_ADDRESS)
+    parser.add_argument("--symbols", action="append", default=[],
+                        help="extra \"address name\" lines, e.g. for an application")
+
+
+class Symbols:
+    def __init__(self, args):
+        self.names = {}
+        rom = read_rom(args.rom)
+        for name, slot in read_defs(args.rom_def):
+            address = rom_word(rom, slot)
+            # slots smolrom leaves empty don't point into it
+            if address is not None and address >= ROM_START:
+                self.names.setdefault(address, name)
+        if args.kernel:
+            kernel = read_kernel(args.kernel, args.kernel_load_address)
+            for name, slot in read_defs(args.kernel_def):
+                address = kernel_word(kernel, slot)
+                if address is not None:
+                    self.names.setdefault(address, name)
+        for path in args.symbols:
+            for line in Path(path).read_text().splitlines():
+                fields = line.split()
+                if len(fields) >= 2:
+                    self.names.setdefault(int(fields[0], 0), fields[1])
+        self.addresses = sorted(self.names)
+
+    # the last routine at or before the address, if it's in the same region
+    def lookup(self, address):
+        index = bisect.bisect_right(self.addresses, address)
+        name = region(address)
+        if index > 0 and region(self.addresses[index - 1]) == name:
+            name = self.names[self.addresses[index - 1]]
+        return name
@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+# replay an instruction trace (TRACE.BIN, see trace.h) into instruction
+# counts per routine, a timeline of page faults and a summary of io ports
+
+import argparse
+import struct
+import sys
+from pathlib import Path
+
+from symbols import Symbols, add_arguments
+
+SECTOR = 512
+
+INSTRUCTION = 0x80
+PAGE_FAULT = 0x81
+IO_READ = 0x82
+IO_WRITE = 0x83
+FRAME = 0x84
+LOST = 0x85
+
+
+# yields (type, values...) for each record, in order
+def records(trace):
+    for number, offset in enumerate(range(0, len(trace) - SECTOR + 1, SECTOR)):
+        length, segment = struct.unpack_from("<HH", trace, offset)
+        if length == 0 or segment != number:
+            return
+        if length > SECTOR - 4:
+            sys.exit(f"segment {segment}: bad length {length}")
+        data = trace[offset + 4:offset + 4 + length]
+        last_pointer = 0
+        position = 0
+        while position < len(data):
+            tag = data[position]
+            position += 1
+            if tag < 0x80:
+                delta = tag - 0x80 if tag & 0x40 else tag
+                last_pointer = (last_pointer + delta) & 0xFFFFFFFF
+                header, = struct.unpack_from("<H", data, position)
+                position += 2
+                yield INSTRUCTION, last_pointer, header
+            elif tag == INSTRUCTION:
+                last_pointer, header = struct.unpack_from("<IH", data, position)
+                position += 6
+                yield INSTRUCTION, last_pointer, header
+            elif tag == PAGE_FAULT:
+                page, = struct.unpack_from("<H", data, position)
+                position += 2
+                yield PAGE_FAULT, page
+            elif tag in (IO_READ, IO_WRITE):
+                port, value = struct.unpack_from("<II", data, position)
+                position += 8
+                yield tag, port, value
+            elif tag == FRAME:
+                yield FRAME,
+            elif tag == LOST:
+                count, = struct.unpack_from("<H", data, position)
+                position += 2
+                yield LOST, count
+            else:
+                sys.exit(f"segment {segment}: bad record {tag:#04x}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="decode an instruction trace")
+    parser.add_argument("trace", help="TRACE.BIN from the SD card")
+    add_arguments(parser)
+    args = parser.parse_args()
+
+    symbols = Symbols(args)
+    trace = Path(args.trace).read_bytes()
+
+    instructions = 0
+    frames = 0
+    lost = 0
+    pointer = 0
+    routines = {}
+    faults = []
+    ports = {}
+    for record in records(trace):
+        kind = record[0]
+        if kind == INSTRUCTION:
+            pointer = record[1]
+            instructions += 1
+            name = symbols.lookup(pointer)
+            routines[name] = routines.get(name, 0) + 1
+        elif kind == PAGE_FAULT:
+            # a fault comes before the instruction that fetched it, or
+            # after the one that touched the data
+            faults.append((instructions, frames, pointer, record[1]))
+        elif kind in (IO_READ, IO_WRITE):
+            key = (record[1], "in" if kind == IO_READ else "out")
+            ports[key] = ports.get(key, 0) + 1
+        elif kind == FRAME:
+            frames += 1
+        elif kind == LOST:
+            lost += record[1]
+
+    print(f"{instructions} instructions, {frames} frames, {len(faults)} page faults, {lost} records lost")
+
+    print()
+    print(f"{'%':>6} {'count':>10}  routine")
+    for name, count in sorted(routines.items(), key=lambda item: -item[1]):
+        print(f"{100 * count / instructions:6.2f} {count:10}  {name}")
+
+    if faults:
+        print()
+        print(f"{'instruction':>11} {'frame':>6} {'pc':>8}  {'page':>4}  routine")
+        for instruction, frame, pointer, page in faults:
+            print(f"{instruction:11} {frame:6} {pointer:08X}  {page:04X}  {symbols.lookup(pointer)}")
+
+    if ports:
+        print()
+        print(f"{'count':>10}  port")
+        for (port, direction), count in sorted(ports.items(), key=lambda item: -item[1]):
+            print(f"{count:10}  {direction} {port:08X}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,200 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <uzebox.h>
+#include <bootlib.h>
+#include <spiram.h>
+
+#include "cpu.h"
+#include "disk.h"
+#include "perf.h"
+#include "trace.h"
+
+#ifdef INSTRUCTION_TRACE
+
+extern sdc_struct_t sd_struct;
+extern disk_controller_t disk_controller;
+extern uint8_t disk_buffer[512];
+
+bool trace_enabled = false;
+bool trace_flush_pending = false;
+
+static uint8_t trace_buffer[TRACE_BUFFER_SIZE];
+static uint16_t trace_length = 0;
+static uint32_t trace_last_pointer = 0;
+static bool trace_stopping = false;
+static bool trace_rewind = false;
+
+// records lost since the last segment, and in the whole trace
+static uint16_t trace_lost = 0;
+static uint32_t trace_lost_total = 0;
+
+static uint32_t trace_file = 0;
+static uint32_t trace_begin = 0;
+static uint32_t trace_pos = 0;
+static uint16_t trace_sectors = 0;
+
+static void append(const uint8_t *record, uint8_t length) {
+    if (trace_length + length > TRACE_BUFFER_SIZE) {
+        if (trace_lost != 0xFFFF) trace_lost++;
+        trace_lost_total++;
+        trace_flush_pending = true;
+        return;
+    }
+    memcpy(trace_buffer + trace_length, record, length);
+    trace_length += length;
+    if (trace_length > TRACE_BUFFER_SIZE - TRACE_HEADROOM) trace_flush_pending = true;
+}
+
+static void put16(uint8_t *bytes, uint16_t value) {
+    bytes[0] = value;
+    bytes[1] = value >> 8;
+}
+
+static void put32(uint8_t *bytes, uint32_t value) {
+    put16(bytes, value);
+    put16(bytes + 2, value >> 16);
+}
+
+void trace_instruction(uint32_t pointer, uint16_t header) {
+    uint8_t record[7];
+    int32_t delta = pointer - trace_last_pointer;
+    trace_last_pointer = pointer;
+    if (delta >= -64 && delta < 64) {
+        record[0] = delta & 0x7F;
+        put16(record + 1, header);
+        append(record, 3);
+    } else {
+        record[0] = TRACE_RECORD_INSTRUCTION;
+        put32(record + 1, pointer);
+        put16(record + 5, header);
+        append(record, 7);
+    }
+}
+
+void trace_page_fault(uint16_t page) {
+    uint8_t record[3] = { TRACE_RECORD_PAGE_FAULT };
+    put16(record + 1, page);
+    append(record, 3);
+}
+
+void trace_io(uint8_t type, uint32_t port, uint32_t value) {
+    uint8_t record[9] = { type };
+    put32(record + 1, port);
+    put32(record + 5, value);
+    append(record, 9);
+}
+
+void trace_frame(void) {
+    uint8_t record[1] = { TRACE_RECORD_FRAME };
+    append(record, 1);
+}
+
+// one sector: length, segment number, then the records. the last one of a
+// trace is empty
+static void write_segment(void) {
+    put16(disk_buffer, trace_length);
+    put16(disk_buffer + 2, trace_sectors);
+    memcpy(disk_buffer + 4, trace_buffer, trace_length);
+    memset(disk_buffer + 4 + trace_length, 0, 512 - 4 - trace_length);
+    FS_Write_Sector(&sd_struct);
+    FS_Next_Sector(&sd_struct);
+    PERF_COUNT(PERF_SD_SECTORS_WRITTEN, 1);
+    trace_sectors++;
+}
+
+// write the buffer out as a segment. this uses disk_buffer and leaves the
+// guest's disk selected
+void trace_flush(fox32_vm_t *vm) {
+    trace_flush_pending = false;
+
+    // the SD card shares the SPI bus with the RAM
+    if (vm->is_consecutive_read) {
+        vm->is_consecutive_read = false;
+        SpiRamSeqReadEnd();
+    }
+
+    uint32_t old_pos = FS_Get_Pos(&sd_struct);
+    if (trace_file == 0) {
+        trace_file = find_file(TRACE_FILENAME);
+        if (trace_file != 0) {
+            FS_Select_Cluster(&sd_struct, trace_file);
+            trace_begin = FS_Get_Pos(&sd_struct);
+        }
+    }
+
+    if (trace_file == 0) {
+        trace_enabled = false;
+    } else {
+        FS_Select_Cluster(&sd_struct, trace_file);
+        if (trace_rewind) {
+            trace_rewind = false;
+            trace_pos = trace_begin;
+        }
+        FS_Set_Pos(&sd_struct, trace_pos);
+
+        SetBorderColor(0x1C);
+        // stop while there is still room for this segment and the empty one
+        // that ends the trace
+        if (trace_sectors + 2 >= TRACE_FILE_SECTORS) trace_stopping = true;
+        if (trace_length != 0) write_segment();
+        if (trace_stopping) {
+            trace_length = 0;
+            write_segment();
+            trace_enabled = false;
+        }
+        trace_pos = FS_Get_Pos(&sd_struct);
+        SetBorderColor(0x00);
+    }
+
+    FS_Select_Cluster(&sd_struct, disk_controller.disks[0].file);
+    FS_Set_Pos(&sd_struct, old_pos);
+
+    // start the next segment afresh, noting anything that didn't fit
+    trace_length = 0;
+    trace_last_pointer = 0;
+    trace_stopping = false;
+    if (trace_lost != 0 && trace_enabled) {
+        uint8_t record[3] = { TRACE_RECORD_LOST };
+        put16(record + 1, trace_lost);
+        append(record, 3);
+    }
+    trace_lost = 0;
+}
+
+// called from an io handler, in the middle of an instruction, so the file
+// is only touched by the next trace_flush
+void trace_command(uint32_t command) {
+    switch (command) {
+        case TRACE_COMMAND_START:
+            trace_enabled = true;
+            trace_stopping = false;
+            trace_rewind = true;
+            trace_sectors = 0;
+            trace_length = 0;
+            trace_last_pointer = 0;
+            trace_lost = 0;
+            trace_lost_total = 0;
+            break;
+        case TRACE_COMMAND_STOP:
+            if (!trace_enabled) break;
+            trace_stopping = true;
+            trace_flush_pending = true;
+            break;
+    }
+}
+
+uint32_t trace_read(uint8_t index) {
+    switch (index) {
+        case 0:
+            return trace_enabled;
+        case 1:
+            return trace_sectors;
+        case 2:
+            return trace_lost_total;
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cpu.h"
+
+// instruction trace, enabled with -DINSTRUCTION_TRACE. while it runs, every
+// instruction, page fault, io port access and video frame is appended to a
+// small buffer, which goes to the trace file a sector at a time between
+// instructions. guest ports 0x8000A000 and up:
+//   write 0x8000A000: TRACE_COMMAND_START or TRACE_COMMAND_STOP. starting
+//   overwrites the file from the beginning
+//   read 0x8000A000: 1 while tracing
+//   read 0x8000A001: sectors written
+//   read 0x8000A002: records lost because the buffer was full
+//
+// the file has to exist already, and tracing stops when TRACE_FILE_SECTORS
+// have been written. each sector holds a 16 bit length and a 16 bit segment
+// number, then that many bytes of records. a trace ends at an empty
+// segment, or one whose number is out of sequence. records:
+//   0x00-0x7F  instruction at the last one's address plus this, as 7 bit
+//              signed, then its 16 bit header
+//   0x80       instruction, 32 bit address, 16 bit header
+//   0x81       page fault, 16 bit page
+//   0x82       io read, 32 bit port, 32 bit value
+//   0x83       io write, 32 bit port, 32 bit value
+//   0x84       video frame
+//   0x85       records lost here, 16 bit count
+// all little endian. the last address starts at 0 in each segment, so they
+// can be decoded on their own. tools/trace_decode.py reads the file
+#define TRACE_FILENAME "TRACE   BIN"
+
+#ifndef TRACE_FILE_SECTORS
+#define TRACE_FILE_SECTORS 2048 // 1 MiB
+#endif
+
+enum {
+    TRACE_COMMAND_STOP = 0,
+    TRACE_COMMAND_START = 1
+};
+
+enum {
+    TRACE_RECORD_INSTRUCTION = 0x80,
+    TRACE_RECORD_PAGE_FAULT,
+    TRACE_RECORD_IO_READ,
+    TRACE_RECORD_IO_WRITE,
+    TRACE_RECORD_FRAME,
+    TRACE_RECORD_LOST
+};
+
+#ifdef INSTRUCTION_TRACE
+// records are held here, and written out once the buffer gets within
+// TRACE_HEADROOM of full, which is more than one instruction can add. a
+// larger buffer wastes less of each sector but costs SRAM
+#ifndef TRACE_BUFFER_SIZE
+#define TRACE_BUFFER_SIZE 256
+#endif
+#define TRACE_HEADROOM 48
+
+extern bool trace_enabled;
+extern bool trace_flush_pending;
+
+void trace_instruction(uint32_t pointer, uint16_t header);
+void trace_page_fault(uint16_t page);
+void trace_io(uint8_t type, uint32_t port, uint32_t value);
+void trace_frame(void);
+void trace_flush(fox32_vm_t *vm);
+void trace_command(uint32_t command);
+uint32_t trace_read(uint8_t index);
+
+#define TRACE_INSTRUCTION(_pointer, _header) \
+    (trace_enabled ? trace_instruction((_pointer), (_header)) : (void) 0)
+#define TRACE_PAGE_FAULT(_page) (trace_enabled ? trace_page_fault((_page)) : (void) 0)
+#define TRACE_IO(_type, _port, _value) \
+    (trace_enabled ? trace_io((_type), (_port), (_value)) : (void) 0)
+#define TRACE_FRAME() (trace_enabled ? trace_frame() : (void) 0)
+// only between instructions, when nothing else is using the SD card
+#define TRACE_SERVICE(_vm) (trace_flush_pending ? trace_flush((_vm)) : (void) 0)
+#else
+#define TRACE_INSTRUCTION(_pointer, _header) ((void) 0)
+#define TRACE_PAGE_FAULT(_page) ((void) 0)
+#define TRACE_IO(_type, _port, _value) ((void) 0)
+#define TRACE_FRAME() ((void) 0)
+#define TRACE_SERVICE(_vm) ((void) 0)
+#endif